@@ -1,2 +1,3 @@
 E:/Program/VulkanSDK/VK_1.3.280.0/Bin/glslangValidator.exe -V ./shader.vert -o ./shader.vert.spv
-E:/Program/VulkanSDK/VK_1.3.280.0/Bin/glslangValidator.exe -V ./shader.frag -o ./shader.frag.spv
\ No newline at end of file
+E:/Program/VulkanSDK/VK_1.3.280.0/Bin/glslangValidator.exe -V ./shader.frag -o ./shader.frag.spv
+E:/Program/VulkanSDK/VK_1.3.280.0/Bin/glslangValidator.exe -V ./shader_compact.vert -o ./shader_compact.vert.spv
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// CompactVertex input, the position dequantization is folded into mvp.model,
+// texcoords are mapped back by mvp.texcoordTransform
+layout(location = 0) in vec4 vertexPos;     // unorm16, relative to the mesh bounds
+layout(location = 1) in vec2 normal;        // snorm16, octahedral
+layout(location = 2) in vec4 tangent;       // snorm8, octahedral xy, bitangent sign w
+layout(location = 3) in vec2 texcoord;      // unorm16, relative to the texcoord bounds
+layout(location = 4) in vec4 color;         // unorm8
+
+layout(location = 0) out vec2 outTexcoord;
+
+layout(set = 0, binding = 0) uniform MVP {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 texcoordTransform;     // scale xy, offset zw
+} mvp;
+
+void main() {
+    gl_Position = mvp.proj * mvp.view * mvp.model * vec4(vertexPos.xyz, 1.0);
+    outTexcoord = texcoord * mvp.texcoordTransform.xy + mvp.texcoordTransform.zw;
+}
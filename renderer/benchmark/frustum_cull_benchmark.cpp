@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "frustum.h"
+#include "frustum_culler.h"
+#include "thread_pool.h"
+
+// Measures boxes culled per second for the scalar Frustum::intersectsBox loop, the SIMD culler
+// on one thread and the SIMD culler split across the thread pool.
+// Usage: frustum_cull_benchmark [boxCount] [iterations]
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const char* name, size_t boxCount, int iterations, size_t visible, double ms) {
+    double perSecond = (double)boxCount * iterations / (ms / 1000.0);
+    std::cout << "    " << name << perSecond / 1e6 << " Mboxes/s, " << visible << " visible (" << ms / iterations << " ms per pass)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t boxCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1 << 20;
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+    // Boxes scattered around the camera, about a tenth of them end up in view
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::uniform_real_distribution<float> size(0.1f, 2.f);
+    std::vector<huahualib::BoundingBox> boxes(boxCount);
+    for (auto& box : boxes) {
+        glm::vec3 center(position(rng), position(rng), position(rng));
+        glm::vec3 extent(size(rng), size(rng), size(rng));
+        box = {center - extent, center + extent};
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 150.f);
+    auto frustum = huahualib::Frustum::fromMatrix(proj * view);
+
+    auto& pool = huahualib::ThreadPool::instance();
+    std::cout << boxCount << " boxes, " << iterations << " iterations, " << pool.size() << " threads\n";
+
+    std::vector<uint8_t> visible(boxCount);
+    size_t visibleCount = 0;
+    auto start = Clock::now();
+    for (int it = 0; it < iterations; ++ it) {
+        visibleCount = 0;
+        for (size_t i = 0; i < boxCount; ++ i) {
+            visible[i] = frustum.intersectsBox(boxes[i]) ? 1 : 0;
+            visibleCount += visible[i];
+        }
+    }
+    report("scalar:   ", boxCount, iterations, visibleCount, elapsedMs(start));
+    std::vector<uint8_t> reference = visible;
+
+    huahualib::FrustumCuller culler;
+    start = Clock::now();
+    culler.assign(boxes);
+    std::cout << "    SoA build " << elapsedMs(start) << " ms" << std::endl;
+
+    start = Clock::now();
+    for (int it = 0; it < iterations; ++ it) {
+        visibleCount = culler.cull(frustum, visible);
+    }
+    report("simd:     ", boxCount, iterations, visibleCount, elapsedMs(start));
+    if (visible != reference) std::cout << "    simd results differ from scalar!" << std::endl;
+
+    start = Clock::now();
+    for (int it = 0; it < iterations; ++ it) {
+        visibleCount = culler.cull(frustum, visible, pool);
+    }
+    report("parallel: ", boxCount, iterations, visibleCount, elapsedMs(start));
+    if (visible != reference) std::cout << "    parallel results differ from scalar!" << std::endl;
+
+    return 0;
+}
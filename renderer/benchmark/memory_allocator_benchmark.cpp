@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "memory_allocator.h"
+
+// Runs MemoryAllocator against a fake memory table, checks the buddy split and merge, alignment,
+// the separate linear and optimal pools, the dedicated threshold and the budget fallbacks,
+// then times a random allocate and free workload. No Vulkan device is needed.
+// Usage: memory_allocator_benchmark [iterations]
+
+using Clock = std::chrono::high_resolution_clock;
+using huahualib::MemoryAllocation;
+using huahualib::MemoryAllocator;
+using huahualib::ResourceTiling;
+
+constexpr vk::DeviceSize kMB = 1ull << 20;
+
+// Heap 0 is device local, heap 1 host visible and heap 2 device local and host visible like ReBAR,
+// with one memory type each. Memory handles are just counters, mapped memory is a host buffer.
+class FakeMemoryBackend final : public huahualib::MemoryBackend {
+public:
+    FakeMemoryBackend(vk::DeviceSize granularity, vk::DeviceSize deviceHeap = 1024 * kMB): granularity_(granularity) {
+        heapSizes_ = {deviceHeap, 256 * kMB, 256 * kMB};
+        heapUsed_.resize(heapSizes_.size(), 0);
+    }
+
+    vk::PhysicalDeviceMemoryProperties memoryProperties() const override {
+        using Flag = vk::MemoryPropertyFlagBits;
+        vk::PhysicalDeviceMemoryProperties properties;
+        properties.memoryHeapCount = (uint32_t)heapSizes_.size();
+        for (uint32_t i = 0; i < heapSizes_.size(); ++ i) {
+            properties.memoryHeaps[i].size = heapSizes_[i];
+            properties.memoryHeaps[i].flags = i == 1 ? vk::MemoryHeapFlags() : vk::MemoryHeapFlagBits::eDeviceLocal;
+        }
+        properties.memoryTypeCount = 3;
+        properties.memoryTypes[0] = vk::MemoryType(Flag::eDeviceLocal, 0);
+        properties.memoryTypes[1] = vk::MemoryType(Flag::eHostVisible | Flag::eHostCoherent, 1);
+        properties.memoryTypes[2] = vk::MemoryType(Flag::eDeviceLocal | Flag::eHostVisible | Flag::eHostCoherent, 2);
+        return properties;
+    }
+
+    vk::DeviceSize bufferImageGranularity() const override {
+        return granularity_;
+    }
+
+    vk::DeviceMemory allocate(vk::DeviceSize size, uint32_t memoryType) override {
+        uint32_t heap = memoryType;
+        if (heapUsed_[heap] + size > heapSizes_[heap]) {
+            return nullptr;
+        }
+        heapUsed_[heap] += size;
+        auto memory = reinterpret_cast<VkDeviceMemory>(static_cast<uintptr_t>(++ next_));
+        live_[memory] = {size, heap};
+        return vk::DeviceMemory(memory);
+    }
+
+    void free(vk::DeviceMemory memory) override {
+        auto it = live_.find(static_cast<VkDeviceMemory>(memory));
+        heapUsed_[it->second.heap] -= it->second.size;
+        live_.erase(it);
+    }
+
+    void* map(vk::DeviceMemory memory) override {
+        auto& live = live_[static_cast<VkDeviceMemory>(memory)];
+        live.host.resize(live.size);
+        return live.host.data();
+    }
+
+    void unmap(vk::DeviceMemory memory) override {
+        live_[static_cast<VkDeviceMemory>(memory)].host.clear();
+    }
+
+    std::vector<huahualib::MemoryHeapBudget> heapBudgets() const override {
+        return budgets;
+    }
+
+    size_t liveCount() const {
+        return live_.size();
+    }
+
+    // What heapBudgets() reports, empty acts like a device without VK_EXT_memory_budget
+    std::vector<huahualib::MemoryHeapBudget> budgets;
+
+private:
+    struct Memory {
+        vk::DeviceSize size;
+        uint32_t heap;
+        std::vector<uint8_t> host;
+    };
+
+    vk::DeviceSize granularity_;
+    std::vector<vk::DeviceSize> heapSizes_;
+    std::vector<vk::DeviceSize> heapUsed_;
+    std::unordered_map<VkDeviceMemory, Memory> live_;
+    uint64_t next_ = 0;
+};
+
+static vk::MemoryRequirements requirements(vk::DeviceSize size, vk::DeviceSize alignment, uint32_t typeBits = 0b111) {
+    return vk::MemoryRequirements(size, alignment, typeBits);
+}
+
+static MemoryAllocation allocateDeviceLocal(MemoryAllocator &allocator, vk::DeviceSize size, vk::DeviceSize alignment,
+                                            ResourceTiling tiling = ResourceTiling::eLinear, bool dedicated = false) {
+    return allocator.allocate(requirements(size, alignment, 0b001), vk::MemoryPropertyFlagBits::eDeviceLocal, {}, tiling, dedicated);
+}
+
+static int failures = 0;
+
+static void check(bool passed, const char* what) {
+    std::cout << "    " << what << ": " << (passed ? "ok" : "FAILED") << std::endl;
+    if (!passed) ++ failures;
+}
+
+static void checkBuddy() {
+    MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1));
+    auto blockSize = allocator.blockSize(0);
+
+    // A fresh block splits down to the lowest nodes in offset order
+    auto a = allocateDeviceLocal(allocator, 1024, 256);
+    auto b = allocateDeviceLocal(allocator, 1024, 256);
+    auto c = allocateDeviceLocal(allocator, 1024, 256);
+    check(a.memory == b.memory && b.memory == c.memory && a.offset == 0 && b.offset == 1024 && c.offset == 2048,
+          "buddy split, lowest offsets first");
+
+    // The freed node is handed out again, split further for a smaller request
+    allocator.free(b);
+    auto d = allocateDeviceLocal(allocator, 512, 256);
+    auto e = allocateDeviceLocal(allocator, 512, 256);
+    check(d.offset == 1024 && e.offset == 1536, "buddy reuses a freed node");
+
+    // Everything free merges back into a single node the size of the block
+    allocator.free(a);
+    allocator.free(c);
+    allocator.free(d);
+    allocator.free(e);
+    auto stats = allocator.stats();
+    check(stats.blockCount == 1 && stats.allocationCount == 0 && stats.largestFree == blockSize && stats.fragmentation == 0.f,
+          "buddy merges free nodes back to the whole block");
+}
+
+static void checkAlignment() {
+    MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1));
+
+    bool aligned = true;
+    std::vector<MemoryAllocation> allocations;
+    const vk::DeviceSize sizes[] = {300, 5000, 256, 70000, 1000};
+    const vk::DeviceSize alignments[] = {4096, 256, 65536, 256, 16384};
+    for (size_t i = 0; i < std::size(sizes); ++ i) {
+        allocations.push_back(allocateDeviceLocal(allocator, sizes[i], alignments[i]));
+        aligned = aligned && allocations.back().offset % alignments[i] == 0;
+        // Nodes are aligned to their own size as well
+        aligned = aligned && allocations.back().offset % std::bit_ceil(std::max(sizes[i], alignments[i])) == 0;
+    }
+    check(aligned, "offsets honour alignment");
+
+    bool disjoint = true;
+    for (size_t i = 0; i < allocations.size(); ++ i) {
+        for (size_t j = i + 1; j < allocations.size(); ++ j) {
+            const auto& x = allocations[i];
+            const auto& y = allocations[j];
+            disjoint = disjoint && (x.memory != y.memory || x.offset + x.size <= y.offset || y.offset + y.size <= x.offset);
+        }
+    }
+    check(disjoint, "allocations don't overlap");
+    for (auto& allocation : allocations) {
+        allocator.free(allocation);
+    }
+}
+
+static void checkTiling() {
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1024));
+        auto buffer = allocateDeviceLocal(allocator, 4096, 256, ResourceTiling::eLinear);
+        auto image = allocateDeviceLocal(allocator, 4096, 256, ResourceTiling::eOptimal);
+        check(buffer.memory != image.memory && allocator.stats().blockCount == 2, "granularity 1024 keeps linear and optimal apart");
+        allocator.free(buffer);
+        allocator.free(image);
+    }
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1));
+        auto buffer = allocateDeviceLocal(allocator, 4096, 256, ResourceTiling::eLinear);
+        auto image = allocateDeviceLocal(allocator, 4096, 256, ResourceTiling::eOptimal);
+        check(buffer.memory == image.memory && allocator.stats().blockCount == 1, "granularity 1 shares blocks");
+        allocator.free(buffer);
+        allocator.free(image);
+    }
+}
+
+static void checkDedicated() {
+    MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1));
+    auto blockSize = allocator.blockSize(0);
+
+    auto half = allocateDeviceLocal(allocator, blockSize / 2, 256);
+    auto over = allocateDeviceLocal(allocator, blockSize / 2 + 1, 256);
+    auto forced = allocateDeviceLocal(allocator, 4096, 256, ResourceTiling::eLinear, true);
+    auto stats = allocator.stats();
+    check(stats.blockCount == 1 && stats.dedicatedCount == 2 && over.offset == 0 && forced.offset == 0 && over.memory != half.memory,
+          "over half a block, or asked for, gets dedicated memory");
+
+    allocator.free(over);
+    allocator.free(forced);
+    check(allocator.stats().dedicatedCount == 0, "dedicated memory is freed");
+    allocator.free(half);
+}
+
+static void checkBudget() {
+    {
+        // 100 MB heap: 8 MB blocks, 12 fit. The next 4 MB resource still fits dedicated, the one after doesn't.
+        auto backend = std::make_unique<FakeMemoryBackend>(1, 100 * kMB);
+        auto fake = backend.get();
+        MemoryAllocator allocator(std::move(backend));
+        std::vector<MemoryAllocation> allocations;
+        for (int i = 0; i < 25; ++ i) {
+            allocations.push_back(allocateDeviceLocal(allocator, 4 * kMB, 256));
+        }
+        auto stats = allocator.stats();
+        check(stats.blockCount == 12 && stats.dedicatedCount == 1, "a full heap falls back to dedicated memory");
+
+        bool threw = false;
+        try {
+            allocateDeviceLocal(allocator, 4 * kMB, 256);
+        } catch (const std::exception &e) {
+            threw = true;
+        }
+        check(threw, "an exhausted heap throws");
+
+        for (auto& allocation : allocations) {
+            allocator.free(allocation);
+        }
+        check(allocator.stats().blockCount == 1 && fake->liveCount() == 1, "one empty block is kept");
+    }
+    {
+        // Host visible memory preferring device local goes to the ReBAR heap while it has budget.
+        // Dedicated requests always take new memory, so every one of them checks the budgets.
+        auto backend = std::make_unique<FakeMemoryBackend>(1);
+        auto fake = backend.get();
+        MemoryAllocator allocator(std::move(backend));
+        auto upload = [&](const std::vector<huahualib::MemoryHeapBudget> &budgets) {
+            fake->budgets = budgets;
+            allocator.updateBudget();
+            return allocator.allocate(requirements(4096, 256), vk::MemoryPropertyFlagBits::eHostVisible,
+                                      vk::MemoryPropertyFlagBits::eDeviceLocal, ResourceTiling::eLinear, true);
+        };
+
+        auto rebar = upload({{0, 1024 * kMB}, {0, 256 * kMB}, {0, 256 * kMB}});
+        auto overBudget = upload({{0, 1024 * kMB}, {0, 256 * kMB}, {256 * kMB, 256 * kMB}});
+        auto nothingFits = upload({{0, 1024 * kMB}, {256 * kMB, 256 * kMB}, {256 * kMB, 256 * kMB}});
+        check(rebar.memoryType == 2 && rebar.map, "preferred flags pick the device local host visible type");
+        check(overBudget.memoryType == 1 && overBudget.map, "a heap over budget is skipped while another fits");
+        check(nothingFits.memoryType == 2, "past the budget only when nothing fits");
+
+        allocator.free(rebar);
+        allocator.free(overBudget);
+        allocator.free(nothingFits);
+    }
+}
+
+static double measure(int iterations, uint32_t operations) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < iterations; ++ i) {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(1024));
+        std::mt19937 rng(7);
+        std::vector<MemoryAllocation> live;
+        auto start = Clock::now();
+        for (uint32_t op = 0; op < operations; ++ op) {
+            // Up to 2048 live allocations of 256 bytes to 1 MB
+            if (live.empty() || (live.size() < 2048 && rng() % 2 == 0)) {
+                auto size = (vk::DeviceSize)256 << (rng() % 12);
+                auto tiling = rng() % 2 ? ResourceTiling::eLinear : ResourceTiling::eOptimal;
+                live.push_back(allocateDeviceLocal(allocator, size + rng() % size, 256, tiling));
+            } else {
+                size_t index = rng() % live.size();
+                allocator.free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+        if (i + 1 == iterations) {
+            auto stats = allocator.stats();
+            std::cout << "    " << live.size() << " live in " << stats.blockCount << " blocks, "
+                      << stats.dedicatedCount << " dedicated, fragmentation " << stats.fragmentation << std::endl;
+        }
+        for (auto& allocation : live) {
+            allocator.free(allocation);
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+
+    std::cout << "Checks" << std::endl;
+    checkBuddy();
+    checkAlignment();
+    checkTiling();
+    checkDedicated();
+    checkBudget();
+
+    uint32_t operations = 100000;
+    std::cout << "Random workload, " << operations << " operations, best of " << iterations << " runs" << std::endl;
+    double ms = measure(iterations, operations);
+    std::cout << "    " << ms << " ms, " << ms * 1e6 / operations << " ns per operation" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "mesh_simplifier.h"
+#include "model.h"
+#include "shader.h"
+
+// Reports post-transform cache statistics of the raw OBJ order and after each optimization pass,
+// then the fill rate of meshlets built from the optimized mesh and a simplified LOD chain.
+// Usage: mesh_optimizer_benchmark [cacheSize] [obj mtlBasedir]...
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const char* name, std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize, double ms) {
+    auto stats = huahualib::analyzeVertexCache(indices, vertexCount, cacheSize);
+    std::cout << "    " << name << "ACMR " << stats.acmr << ", ATVR " << stats.atvr;
+    if (ms > 0) std::cout << " (" << ms << " ms)";
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    uint32_t cacheSize = argc > 1 ? std::max(3, std::atoi(argv[1])) : 16;
+
+    std::vector<std::pair<std::string, std::string>> files;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        files.emplace_back(argv[i], argv[i + 1]);
+    }
+    if (files.empty()) {
+        std::string modelDir = huahualib::ROOT_PATH + "renderer/assets/models/";
+        files.emplace_back(modelDir + "Red/Red.obj", modelDir + "Red");
+        files.emplace_back(modelDir + "keqing/keqing.obj", modelDir + "keqing");
+    }
+
+    huahualib::ModelLoadOptions raw;
+    raw.optimizeVertexCache = false;
+    raw.optimizeOverdraw = false;
+    raw.optimizeVertexFetch = false;
+
+    for (auto& [objFilename, mtlBasedir] : files) {
+        huahualib::Model model(objFilename, mtlBasedir, raw);
+        std::vector<huahualib::Vertex> vertices(model.vertices().begin(), model.vertices().end());
+        std::vector<uint32_t> indices(model.indices().begin(), model.indices().end());
+
+        std::cout << objFilename << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, cache " << cacheSize << "\n";
+        report("raw:       ", indices, vertices.size(), cacheSize, 0);
+
+        auto start = Clock::now();
+        huahualib::optimizeVertexCache(indices, vertices.size());
+        report("cache:     ", indices, vertices.size(), cacheSize, elapsedMs(start));
+
+        start = Clock::now();
+        huahualib::optimizeOverdraw(indices, vertices, cacheSize);
+        report("overdraw:  ", indices, vertices.size(), cacheSize, elapsedMs(start));
+
+        start = Clock::now();
+        huahualib::optimizeVertexFetch(vertices, indices);
+        report("fetch:     ", indices, vertices.size(), cacheSize, elapsedMs(start));
+
+        huahualib::MeshletLimits limits;
+        huahualib::MeshletData meshlets;
+        start = Clock::now();
+        huahualib::buildMeshlets(indices, vertices, limits, meshlets);
+        double meshletMs = elapsedMs(start);
+        report("meshlets:  ", indices, vertices.size(), cacheSize, meshletMs);
+
+        auto stats = huahualib::analyzeMeshlets(meshlets, limits, vertices.size());
+        std::cout << "    " << stats.meshletCount << " meshlets (" << limits.maxVertices << "/" << limits.maxTriangles << "), "
+                  << "vertex fill " << stats.vertexFill * 100.f << "%, triangle fill " << stats.triangleFill * 100.f << "%, "
+                  << "vertex duplication " << stats.vertexDuplication << std::endl;
+
+        glm::vec3 minPos = vertices[0].pos, maxPos = vertices[0].pos;
+        for (const auto& v : vertices) {
+            minPos = glm::min(minPos, v.pos);
+            maxPos = glm::max(maxPos, v.pos);
+        }
+        huahualib::SimplifyOptions simplify;
+        simplify.targetError = 0.05f * glm::length(maxPos - minPos) * 0.5f;
+
+        std::vector<uint32_t> lod;
+        for (float ratio : {0.5f, 0.25f, 0.125f}) {
+            start = Clock::now();
+            float error = huahualib::simplifyMesh(indices, vertices, (size_t)(indices.size() / 3 * ratio) * 3, simplify, lod);
+            std::cout << "    lod " << ratio << ": " << lod.size() / 3 << " triangles, error " << error
+                      << " (" << elapsedMs(start) << " ms)" << std::endl;
+        }
+    }
+
+    return 0;
+}
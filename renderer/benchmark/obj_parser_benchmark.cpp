@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "obj_parser.h"
+#include "shader.h"
+#include "tiny_obj_loader.h"
+
+// Compares tinyobj::LoadObj with the in-tree parallel ObjParser.
+// Usage: obj_parser_benchmark [iterations] [obj mtlBasedir]...
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct ObjResult {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+// ObjParser rounds correctly, tinyobj may be a bit off, so values only have to agree to float precision
+static bool sameValues(const std::vector<tinyobj::real_t> &a, const std::vector<tinyobj::real_t> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++ i) {
+        if (std::abs(a[i] - b[i]) > std::numeric_limits<tinyobj::real_t>::epsilon() * std::max<tinyobj::real_t>(1, std::abs(a[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameIndices(const std::vector<tinyobj::shape_t> &a, const std::vector<tinyobj::shape_t> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++ i) {
+        const auto& x = a[i].mesh;
+        const auto& y = b[i].mesh;
+        if (x.indices.size() != y.indices.size() || x.material_ids != y.material_ids) return false;
+        for (size_t j = 0; j < x.indices.size(); ++ j) {
+            if (x.indices[j].vertex_index != y.indices[j].vertex_index ||
+                x.indices[j].normal_index != y.indices[j].normal_index ||
+                x.indices[j].texcoord_index != y.indices[j].texcoord_index) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Func>
+static double measure(int iterations, Func&& func) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < iterations; ++ i) {
+        auto start = Clock::now();
+        func();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+
+    std::vector<std::pair<std::string, std::string>> files;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        files.emplace_back(argv[i], argv[i + 1]);
+    }
+    if (files.empty()) {
+        std::string modelDir = huahualib::ROOT_PATH + "renderer/assets/models/";
+        files.emplace_back(modelDir + "Red/Red.obj", modelDir + "Red");
+        files.emplace_back(modelDir + "keqing/keqing.obj", modelDir + "keqing");
+    }
+
+    auto& pool = huahualib::ThreadPool::instance();
+    std::cout << "Threads: " << pool.size() << ", best of " << iterations << " runs" << std::endl;
+
+    for (auto& [objFilename, mtlBasedir] : files) {
+        ObjResult reference, parallel;
+        std::string warn, err;
+
+        double tinyobjMs = measure(iterations, [&]() {
+            reference = ObjResult();
+            if (!tinyobj::LoadObj(&reference.attrib, &reference.shapes, &reference.materials, &warn, &err, objFilename.c_str(), mtlBasedir.c_str())) {
+                throw std::runtime_error("Failed to load .obj file: " + objFilename + "\n");
+            }
+        });
+
+        huahualib::ObjParser parser(pool);
+        double parallelMs = measure(iterations, [&]() {
+            parallel = ObjResult();
+            if (!parser.load(&parallel.attrib, &parallel.shapes, &parallel.materials, &warn, &err, objFilename, mtlBasedir)) {
+                throw std::runtime_error("Failed to load .obj file: " + objFilename + "\n");
+            }
+        });
+
+        bool same = sameValues(reference.attrib.vertices, parallel.attrib.vertices) &&
+                    sameValues(reference.attrib.normals, parallel.attrib.normals) &&
+                    sameValues(reference.attrib.texcoords, parallel.attrib.texcoords) &&
+                    sameIndices(reference.shapes, parallel.shapes);
+
+        std::cout << objFilename << "\n"
+                  << "    tinyobj:   " << tinyobjMs << " ms\n"
+                  << "    ObjParser: " << parallelMs << " ms (x" << tinyobjMs / parallelMs << ")\n"
+                  << "    output:    " << (same ? "same" : "DIFFERENT") << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_vulkan.h"
+
+#include "huahualib.h"
+#include "texture.h"
+#include "thread_pool.h"
+
+// Compares loading every image of a directory one TextureManager::load at a time
+// with TextureManager::loadBatch, which decodes on the thread pool while uploading.
+// Needs a Vulkan device, a hidden window provides the surface.
+// Usage: texture_load_benchmark [directory] [iterations]
+
+using Clock = std::chrono::high_resolution_clock;
+
+template<typename Load>
+static double measure(int iterations, huahualib::TextureManager &manager, Load&& load) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < iterations; ++ i) {
+        auto start = Clock::now();
+        load();
+        // Uploads are asynchronous, a load isn't done until the GPU has the texels
+        auto& uploads = *huahualib::Context::getInstance().uploadQueuePtr;
+        uploads.wait(uploads.lastSubmitted());
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        // Loaded textures would be cache hits in the next run
+        manager.clear();
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    std::string directory = argc > 1 ? argv[1] : huahualib::ROOT_PATH + "renderer/assets/models/keqing/tex";
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+    std::vector<std::string> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        auto extension = entry.path().extension().string();
+        if (extension == ".png" || extension == ".jpg" || extension == ".tga" || extension == ".bmp") {
+            files.push_back(entry.path().string());
+        }
+    }
+    if (files.empty()) {
+        std::cout << "No images in " << directory << std::endl;
+        return 1;
+    }
+
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_Window *window = SDL_CreateWindow("texture_load_benchmark", 0, 0, 64, 64, SDL_WINDOW_HIDDEN | SDL_WINDOW_VULKAN);
+    if (!window) {
+        SDL_Log("Create window failed.");
+        return 2;
+    }
+
+    uint32_t count;
+    SDL_Vulkan_GetInstanceExtensions(window, &count, nullptr);
+    std::vector<const char*> extensions(count);
+    SDL_Vulkan_GetInstanceExtensions(window, &count, extensions.data());
+    huahualib::init(extensions,
+        [&](vk::Instance instance) -> VkSurfaceKHR {
+            VkSurfaceKHR surface;
+            if (!SDL_Vulkan_CreateSurface(window, instance, &surface)) {
+                throw std::runtime_error("Failed to create surface!");
+            }
+            return surface;
+        }, 64, 64);
+
+    {
+        huahualib::TextureManager manager;
+        std::cout << files.size() << " images in " << directory << ", threads: " << huahualib::ThreadPool::instance().size()
+                  << ", best of " << iterations << " runs" << std::endl;
+
+        double serialMs = measure(iterations, manager, [&]() {
+            for (const auto& file : files) {
+                manager.load(file);
+            }
+        });
+        double batchMs = measure(iterations, manager, [&]() {
+            manager.loadBatch(files);
+        });
+
+        std::cout << "    load:      " << serialMs << " ms\n"
+                  << "    loadBatch: " << batchMs << " ms (x" << serialMs / batchMs << ")" << std::endl;
+    }
+
+    huahualib::quit();
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return 0;
+}
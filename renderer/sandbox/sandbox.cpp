@@ -82,11 +82,14 @@ int main(int argc, char** argv) {
     // std::string mtlBasedir = huahualib::ROOT_PATH + "renderer/assets/models/keqing";
     std::string objFilename = huahualib::ROOT_PATH + "renderer/assets/models/Red/Red.obj";
     std::string mtlBasedir = huahualib::ROOT_PATH + "renderer/assets/models/Red";
-    huahualib::Model model(objFilename, mtlBasedir);
+    huahualib::ModelLoadOptions options;
+    options.vertexFormat = huahualib::VertexFormat::eCompact;
+    options.buildMeshlets = true;
+    options.lodCount = 4;
+    huahualib::Model model(objFilename, mtlBasedir, options);
     
     auto renderer = huahualib::getRenderer();
-    renderer->bindVertices(model.vertices());
-    renderer->bindIndices(model.indices());
+    renderer->bindModel(model);
 
     while (!shouldClose) {
         while (SDL_PollEvent(&event)) {
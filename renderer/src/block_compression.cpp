@@ -0,0 +1,346 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace huahualib {
+
+namespace {
+
+struct Color565 {
+    uint16_t packed;
+    int r, g, b;    // expanded back to 8 bits
+};
+
+Color565 quantize565(float r, float g, float b) {
+    int r5 = std::clamp((int)std::lround(r * 31.f / 255.f), 0, 31);
+    int g6 = std::clamp((int)std::lround(g * 63.f / 255.f), 0, 63);
+    int b5 = std::clamp((int)std::lround(b * 31.f / 255.f), 0, 31);
+    return {(uint16_t)(r5 << 11 | g6 << 5 | b5), r5 << 3 | r5 >> 2, g6 << 2 | g6 >> 4, b5 << 3 | b5 >> 2};
+}
+
+// Dominant direction of the points by power iteration on their covariance
+void principalAxis(const float (*points)[4], int count, int channels, float* mean, float* axis) {
+    for (int c = 0; c < channels; ++ c) {
+        mean[c] = 0.f;
+        for (int i = 0; i < count; ++ i) mean[c] += points[i][c];
+        mean[c] /= count;
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < count; ++ i) {
+        for (int a = 0; a < channels; ++ a) {
+            for (int b = 0; b < channels; ++ b) {
+                cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    for (int c = 0; c < channels; ++ c) axis[c] = 1.f;
+    for (int iter = 0; iter < 8; ++ iter) {
+        float next[4] = {};
+        for (int a = 0; a < channels; ++ a) {
+            for (int b = 0; b < channels; ++ b) next[a] += cov[a][b] * axis[b];
+        }
+        float length = 0.f;
+        for (int c = 0; c < channels; ++ c) length += next[c] * next[c];
+        if (length < 1e-12f) break;
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; ++ c) axis[c] = next[c] / length;
+    }
+}
+
+// Endpoints at the extremes of the points projected on their principal axis
+void fitEndpoints(const float (*points)[4], int count, int channels, float* e0, float* e1) {
+    float mean[4], axis[4];
+    principalAxis(points, count, channels, mean, axis);
+
+    float lo = 0.f, hi = 0.f;
+    for (int i = 0; i < count; ++ i) {
+        float t = 0.f;
+        for (int c = 0; c < channels; ++ c) t += (points[i][c] - mean[c]) * axis[c];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    for (int c = 0; c < channels; ++ c) {
+        e0[c] = std::clamp(mean[c] + axis[c] * hi, 0.f, 255.f);
+        e1[c] = std::clamp(mean[c] + axis[c] * lo, 0.f, 255.f);
+    }
+}
+
+int colorDistance(const int* a, const uint8_t* b) {
+    int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+// BC1 color block. threeColor allows the 3 color + transparent mode for texels with alpha < 128,
+// BC3 passes false since its color block is always decoded in 4 color mode.
+void compressColorBlock(const uint8_t* rgba, uint8_t* out, bool threeColor) {
+    float points[16][4];
+    int count = 0;
+    bool transparent = false;
+    for (int i = 0; i < 16; ++ i) {
+        const uint8_t* texel = rgba + 4 * i;
+        if (threeColor && texel[3] < 128) {
+            transparent = true;
+            continue;
+        }
+        points[count][0] = texel[0];
+        points[count][1] = texel[1];
+        points[count][2] = texel[2];
+        ++ count;
+    }
+
+    uint16_t c0 = 0, c1 = 0;
+    uint32_t indices = 0;
+    if (count > 0) {
+        float e0[4], e1[4];
+        fitEndpoints(points, count, 3, e0, e1);
+        Color565 q0 = quantize565(e0[0], e0[1], e0[2]);
+        Color565 q1 = quantize565(e1[0], e1[1], e1[2]);
+
+        int palette[4][3];
+        int paletteSize = transparent ? 3 : 4;
+        // The decoder picks the mode from the endpoint order: c0 > c1 is 4 colors, c0 <= c1 is 3 colors
+        if ((q0.packed < q1.packed) != transparent && q0.packed != q1.packed) std::swap(q0, q1);
+        c0 = q0.packed;
+        c1 = q1.packed;
+        int ends[2][3] = {{q0.r, q0.g, q0.b}, {q1.r, q1.g, q1.b}};
+        for (int c = 0; c < 3; ++ c) {
+            palette[0][c] = ends[0][c];
+            palette[1][c] = ends[1][c];
+            if (paletteSize == 4) {
+                palette[2][c] = (2 * ends[0][c] + ends[1][c]) / 3;
+                palette[3][c] = (ends[0][c] + 2 * ends[1][c]) / 3;
+            } else {
+                palette[2][c] = (ends[0][c] + ends[1][c]) / 2;
+            }
+        }
+        // Equal endpoints decode as 3 color mode, keep every opaque texel on index 0
+        if (c0 == c1) paletteSize = 1;
+
+        for (int i = 0; i < 16; ++ i) {
+            const uint8_t* texel = rgba + 4 * i;
+            uint32_t best = 0;
+            if (transparent && texel[3] < 128) {
+                best = 3;
+            } else {
+                int bestDistance = colorDistance(palette[0], texel);
+                for (int p = 1; p < paletteSize; ++ p) {
+                    int distance = colorDistance(palette[p], texel);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    } else {
+        // Fully transparent, 3 color mode with every texel on the transparent index
+        indices = 0xffffffffu;
+    }
+
+    memcpy(out, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// BC4 single channel block in 8 value mode
+void compressChannelBlock(const uint8_t* rgba, int channel, uint8_t* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++ i) {
+        lo = std::min(lo, (int)rgba[4 * i + channel]);
+        hi = std::max(hi, (int)rgba[4 * i + channel]);
+    }
+
+    // a0 > a1 selects 8 values: a0, a1 and six interpolated between them
+    int palette[8] = {hi, lo};
+    for (int k = 1; k <= 6; ++ k) {
+        palette[k + 1] = ((7 - k) * hi + k * lo) / 7;
+    }
+
+    uint64_t indices = 0;
+    if (hi != lo) {
+        for (int i = 0; i < 16; ++ i) {
+            int value = rgba[4 * i + channel];
+            uint64_t best = 0;
+            int bestDistance = std::abs(palette[0] - value);
+            for (int p = 1; p < 8; ++ p) {
+                int distance = std::abs(palette[p] - value);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (3 * i);
+        }
+    }
+
+    out[0] = (uint8_t)hi;
+    out[1] = (uint8_t)lo;
+    for (int b = 0; b < 6; ++ b) {
+        out[2 + b] = (uint8_t)(indices >> (8 * b));
+    }
+}
+
+constexpr int kBC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out): out_(out) {
+        memset(out_, 0, 16);
+    }
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; ++ i, ++ pos_) {
+            if (value >> i & 1) out_[pos_ >> 3] |= (uint8_t)(1 << (pos_ & 7));
+        }
+    }
+
+private:
+    uint8_t* out_;
+    int pos_ = 0;
+};
+
+struct BC7Mode6 {
+    int endpoints[2][4];    // 7 bit per channel
+    int pbits[2];
+    int indices[16];
+    int error = std::numeric_limits<int>::max();
+};
+
+// Quantizes both endpoints with the given p-bits, assigns indices and measures the error
+void evaluateMode6(const uint8_t* rgba, const float* e0, const float* e1, int p0, int p1, BC7Mode6 &result) {
+    BC7Mode6 candidate;
+    candidate.pbits[0] = p0;
+    candidate.pbits[1] = p1;
+    int ends[2][4];
+    for (int c = 0; c < 4; ++ c) {
+        candidate.endpoints[0][c] = std::clamp((int)std::lround((e0[c] - p0) / 2.f), 0, 127);
+        candidate.endpoints[1][c] = std::clamp((int)std::lround((e1[c] - p1) / 2.f), 0, 127);
+        ends[0][c] = candidate.endpoints[0][c] << 1 | p0;
+        ends[1][c] = candidate.endpoints[1][c] << 1 | p1;
+    }
+
+    int palette[16][4];
+    for (int k = 0; k < 16; ++ k) {
+        for (int c = 0; c < 4; ++ c) {
+            palette[k][c] = ((64 - kBC7Weights4[k]) * ends[0][c] + kBC7Weights4[k] * ends[1][c] + 32) >> 6;
+        }
+    }
+
+    candidate.error = 0;
+    for (int i = 0; i < 16; ++ i) {
+        const uint8_t* texel = rgba + 4 * i;
+        int best = 0, bestDistance = std::numeric_limits<int>::max();
+        for (int k = 0; k < 16; ++ k) {
+            int distance = 0;
+            for (int c = 0; c < 4; ++ c) {
+                int d = palette[k][c] - texel[c];
+                distance += d * d;
+            }
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = k;
+            }
+        }
+        candidate.indices[i] = best;
+        candidate.error += bestDistance;
+    }
+
+    if (candidate.error < result.error) result = candidate;
+}
+
+}
+
+uint32_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::eBC1 ? 8 : 16;
+}
+
+vk::Format blockVkFormat(BlockFormat format, bool srgb) {
+    switch (format) {
+        case BlockFormat::eBC1: return srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+        case BlockFormat::eBC3: return srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+        case BlockFormat::eBC5: return vk::Format::eBc5UnormBlock;
+        case BlockFormat::eBC7: return srgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+    }
+    return vk::Format::eUndefined;
+}
+
+void compressBlockBC1(const uint8_t* rgba, uint8_t* out) {
+    compressColorBlock(rgba, out, true);
+}
+
+void compressBlockBC3(const uint8_t* rgba, uint8_t* out) {
+    compressChannelBlock(rgba, 3, out);
+    compressColorBlock(rgba, out + 8, false);
+}
+
+void compressBlockBC5(const uint8_t* rgba, uint8_t* out) {
+    compressChannelBlock(rgba, 0, out);
+    compressChannelBlock(rgba, 1, out + 8);
+}
+
+void compressBlockBC7(const uint8_t* rgba, uint8_t* out) {
+    // Mode 6: one subset, 7 bit RGBA endpoints with a p-bit each, 4 bit indices
+    float points[16][4];
+    for (int i = 0; i < 16; ++ i) {
+        for (int c = 0; c < 4; ++ c) points[i][c] = rgba[4 * i + c];
+    }
+    float e0[4], e1[4];
+    fitEndpoints(points, 16, 4, e0, e1);
+
+    BC7Mode6 best;
+    for (int p = 0; p < 4; ++ p) {
+        evaluateMode6(rgba, e0, e1, p & 1, p >> 1, best);
+    }
+
+    // The first index is stored with its top bit implied zero, swap the endpoints when it is set
+    if (best.indices[0] & 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (auto& index : best.indices) index = 15 - index;
+    }
+
+    BitWriter writer(out);
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; ++ c) {
+        writer.write(best.endpoints[0][c], 7);
+        writer.write(best.endpoints[1][c], 7);
+    }
+    writer.write(best.pbits[0], 1);
+    writer.write(best.pbits[1], 1);
+    writer.write(best.indices[0], 3);
+    for (int i = 1; i < 16; ++ i) {
+        writer.write(best.indices[i], 4);
+    }
+}
+
+void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t w, uint32_t h, std::vector<uint8_t> &out, ThreadPool &pool) {
+    uint32_t blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+    uint32_t bytes = blockBytes(format);
+    out.resize((size_t)blocksX * blocksY * bytes);
+
+    auto compressBlock = format == BlockFormat::eBC1 ? compressBlockBC1 :
+                         format == BlockFormat::eBC3 ? compressBlockBC3 :
+                         format == BlockFormat::eBC5 ? compressBlockBC5 : compressBlockBC7;
+
+    pool.parallelFor(blocksY, [&](size_t by) {
+        uint8_t block[64];
+        for (uint32_t bx = 0; bx < blocksX; ++ bx) {
+            for (uint32_t y = 0; y < 4; ++ y) {
+                uint32_t sy = std::min(h - 1, (uint32_t)by * 4 + y);
+                for (uint32_t x = 0; x < 4; ++ x) {
+                    uint32_t sx = std::min(w - 1, bx * 4 + x);
+                    memcpy(block + 4 * (4 * y + x), rgba + 4 * ((size_t)sy * w + sx), 4);
+                }
+            }
+            compressBlock(block, out.data() + (by * blocksX + bx) * bytes);
+        }
+    });
+}
+
+}
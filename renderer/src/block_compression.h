@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "thread_pool.h"
+
+namespace huahualib {
+
+// Block compressed formats the offline encoder writes, all of them 4x4 texel blocks.
+//   eBC1: RGB + 1 bit alpha, 8 bytes
+//   eBC3: RGB + smooth alpha, 16 bytes
+//   eBC5: two independent channels (normal map XY), 16 bytes
+//   eBC7: RGBA, 16 bytes, encoded with mode 6 only
+enum class BlockFormat : uint32_t {
+    eBC1,
+    eBC3,
+    eBC5,
+    eBC7,
+};
+
+uint32_t blockBytes(BlockFormat format);
+// BC5 has no sRGB variant and always maps to UNORM
+vk::Format blockVkFormat(BlockFormat format, bool srgb);
+
+// Each takes a 4x4 block of RGBA8 texels in row order
+void compressBlockBC1(const uint8_t* rgba, uint8_t* out);
+void compressBlockBC3(const uint8_t* rgba, uint8_t* out);
+void compressBlockBC5(const uint8_t* rgba, uint8_t* out);
+void compressBlockBC7(const uint8_t* rgba, uint8_t* out);
+
+// Compresses a whole RGBA8 image, block rows are spread over the pool.
+// Partial edge blocks repeat the last row and column of the image.
+void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t w, uint32_t h, std::vector<uint8_t> &out,
+                   ThreadPool &pool = ThreadPool::instance());
+
+}
@@ -3,8 +3,9 @@
 
 namespace huahualib {
 
-Buffer::Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property): size(size) {
-    auto& device = Context::getInstance().device;
+Buffer::Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property, vk::MemoryPropertyFlags preferred): size(size) {
+    auto& ctx = Context::getInstance();
+    auto& device = ctx.device;
 
     // Create buffer
     vk::BufferCreateInfo bufferInfo;
@@ -14,46 +15,21 @@ Buffer::Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags
         .setSharingMode(vk::SharingMode::eExclusive);
     buffer = device.createBuffer(bufferInfo);
 
-    // Query memory size and type
+    // Sub-allocate memory, host visible memory comes mapped
     auto requirements = device.getBufferMemoryRequirements(buffer);
     requireSize = requirements.size;
-    auto memTypeIndex = queryMemoryInfo(requirements.memoryTypeBits, property);
-
-    // Allocate memory
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo
-        .setMemoryTypeIndex(memTypeIndex)
-        .setAllocationSize(requireSize);
-    memory = device.allocateMemory(allocInfo);
+    memory = ctx.memoryAllocatorPtr->allocate(requirements, property, preferred, ResourceTiling::eLinear);
 
     // Bind Buffer to memory
-    device.bindBufferMemory(buffer, memory, 0);
-
-    // Map memory
-    if (property & vk::MemoryPropertyFlagBits::eHostVisible) {
-        map = device.mapMemory(memory, 0, size);
-    } else {
-        map = nullptr;
-    }
-}
+    device.bindBufferMemory(buffer, memory.memory, memory.offset);
 
-Buffer::~Buffer() {
-    auto device = Context::getInstance().device;
-    if (map) device.unmapMemory(memory);
-    device.freeMemory(memory);
-    device.destroyBuffer(buffer);
+    map = memory.map;
 }
 
-uint32_t Buffer::queryMemoryInfo(size_t memTypeBits, vk::MemoryPropertyFlags memProperty) {
-    auto properties = Context::getInstance().phyDevice.getMemoryProperties();
-    for (int i = 0; i < properties.memoryTypeCount; ++ i) {
-        if ((i << 1) & memTypeBits && properties.memoryTypes[i].propertyFlags & memProperty) {
-            return i;
-            break;
-        }
-    }
-
-    return 0;
+Buffer::~Buffer() {
+    auto& ctx = Context::getInstance();
+    ctx.device.destroyBuffer(buffer);
+    ctx.memoryAllocatorPtr->free(memory);
 }
 
 }
\ No newline at end of file
@@ -1,22 +1,21 @@
 #pragma once
 
 #include "vulkan/vulkan.hpp"
+#include "memory_allocator.h"
 
 namespace huahualib {
 
 class Buffer final {
 public:
     vk::Buffer buffer;
-    vk::DeviceMemory memory;
+    MemoryAllocation memory;
     void* map;
     size_t size, requireSize;
 
-    Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property);
+    // preferred flags are taken when some memory type has them, e.g. device local for uniforms on ReBAR
+    Buffer(size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags property, vk::MemoryPropertyFlags preferred = {});
     ~Buffer();
 
-private:
-    uint32_t queryMemoryInfo(size_t memTypeBits, vk::MemoryPropertyFlags memProperty);
-
 };
 
 }
\ No newline at end of file
@@ -62,20 +62,11 @@ void CommandManager::freeCommand(vk::CommandBuffer buffer) {
 }
 
 
-void CommandManager::exceuteCommand(vk::Queue queue, RecordCmdFunc func) {
-    auto cmdBuf = createCommandBuffers(1)[0];
-    vk::CommandBufferBeginInfo beginInfo;
-    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-    cmdBuf.begin(beginInfo);
+UploadToken CommandManager::exceuteCommand(RecordCmdFunc func) {
+    auto& uploads = *Context::getInstance().uploadQueuePtr;
+    auto cmdBuf = uploads.acquire();
         if (func) func(cmdBuf);
-    cmdBuf.end();
-
-    vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBuffers(cmdBuf);
-    queue.submit(submitInfo);
-    queue.waitIdle();
-    Context::getInstance().device.waitIdle();
-    freeCommand(cmdBuf);
+    return uploads.submit(cmdBuf);
 }
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include "vulkan/vulkan.hpp"
+#include "upload_queue.h"
 
 namespace huahualib {
 
@@ -16,7 +17,8 @@ public:
     std::vector<vk::CommandBuffer> createCommandBuffers(uint32_t count);
     void resetCommand();
     void freeCommand(vk::CommandBuffer buffer);
-    void exceuteCommand(vk::Queue queue, RecordCmdFunc func);
+    // Submits through the upload queue without waiting, frames wait for the token on the GPU
+    UploadToken exceuteCommand(RecordCmdFunc func);
 
 private:
     vk::CommandPool cmdPool_;
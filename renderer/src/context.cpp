@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <string_view>
 #include "context.h"
 
 namespace huahualib {
@@ -63,34 +65,43 @@ void Context::createSurface(CreateSurfaceFunc func) {
 
 void Context::createDevice(vk::SurfaceKHR surface) {
     std::vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    // Heap budgets keep the memory allocator from overcommitting, optional
+    for (const auto& extension : phyDevice.enumerateDeviceExtensionProperties()) {
+        if (std::string_view(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            memoryBudget = true;
+        }
+    }
     vk::DeviceCreateInfo deviceInfo;
     std::vector<vk::DeviceQueueCreateInfo> queueInfos;
     float priority = 1.f;
     queryQueueFamilyIndices(surface);
-    if (queueFamilyIndices.graphicsQueue.value() == queueFamilyIndices.presentQueue.value()) {
-        vk::DeviceQueueCreateInfo queueInfo;
-        queueInfo
-            .setPQueuePriorities(&priority)
-            .setQueueCount(1)
-            .setQueueFamilyIndex(queueFamilyIndices.graphicsQueue.value());
-        queueInfos.push_back(std::move(queueInfo));
-    } else {
+    std::vector<uint32_t> families = {queueFamilyIndices.graphicsQueue.value(), queueFamilyIndices.presentQueue.value()};
+    if (queueFamilyIndices.transferQueue) families.push_back(queueFamilyIndices.transferQueue.value());
+    if (queueFamilyIndices.computeQueue) families.push_back(queueFamilyIndices.computeQueue.value());
+    std::sort(families.begin(), families.end());
+    families.erase(std::unique(families.begin(), families.end()), families.end());
+    for (auto family : families) {
         vk::DeviceQueueCreateInfo queueInfo;
         queueInfo
             .setPQueuePriorities(&priority)
             .setQueueCount(1)
-            .setQueueFamilyIndex(queueFamilyIndices.graphicsQueue.value());
-        queueInfos.push_back(std::move(queueInfo));
-        queueInfo
-            .setPQueuePriorities(&priority)
-            .setQueueCount(1)
-            .setQueueFamilyIndex(queueFamilyIndices.presentQueue.value());
+            .setQueueFamilyIndex(family);
         queueInfos.push_back(std::move(queueInfo));
     }
 
+    // Block compressed textures are used whenever the device can sample them
+    vk::PhysicalDeviceFeatures features;
+    features.setTextureCompressionBC(phyDevice.getFeatures().textureCompressionBC);
+    // The upload queue signals a timeline semaphore, core since Vulkan 1.2
+    vk::PhysicalDeviceVulkan12Features features12;
+    features12.setTimelineSemaphore(true);
+
     deviceInfo
+        .setPNext(&features12)
         .setQueueCreateInfos(queueInfos)
-        .setPEnabledExtensionNames(extensions);
+        .setPEnabledExtensionNames(extensions)
+        .setPEnabledFeatures(&features);
 
     try {
         device = phyDevice.createDevice(deviceInfo);
@@ -114,6 +125,7 @@ void Context::initRenderProcess() {
 
 void Context::initGraphicsPipeline() {
     renderProcessPtr->createGraphicsPipeline(*shaderManagerPtr->get(0));
+    renderProcessPtr->createCompactGraphicsPipeline(*shaderManagerPtr->get(1));
 }
 
 void Context::initDescriptorPool(uint32_t maxFlight) {
@@ -124,35 +136,62 @@ void Context::initShaderModule() {
     auto vertexSource = readWholeFile(ROOT_PATH + "renderer/assets/shaders/shader.vert.spv");
     auto fragmentSource = readWholeFile(ROOT_PATH + "renderer/assets/shaders/shader.frag.spv");
     shaderManagerPtr->createShader(vertexSource, fragmentSource);
+
+    // Same fragment stage, CompactVertex input
+    auto compactVertexSource = readWholeFile(ROOT_PATH + "renderer/assets/shaders/shader_compact.vert.spv");
+    shaderManagerPtr->createShader(compactVertexSource, fragmentSource);
 }
 
 void Context::initShaderManager() {
     shaderManagerPtr.reset(new ShaderManager);
 }
 
-void Context::initTextureManager() {
-    textureManagerPtr.reset(new TextureManager);
+void Context::initTextureManager(uint32_t maxFlight) {
+    textureManagerPtr.reset(new TextureManager(maxFlight));
+}
+
+void Context::initMemoryAllocator() {
+    memoryAllocatorPtr.reset(new MemoryAllocator(std::make_unique<DeviceMemoryBackend>(phyDevice, device, memoryBudget)));
+}
+
+void Context::initUploadQueue() {
+    uploadQueuePtr.reset(new UploadQueue(graphicsQueue, queueFamilyIndices.graphicsQueue.value()));
+    if (queueFamilyIndices.transferQueue) {
+        transferUploadQueuePtr.reset(new UploadQueue(transferQueue, queueFamilyIndices.transferQueue.value()));
+    }
+}
+
+void Context::initStagingRing() {
+    stagingRingPtr.reset(new StagingRing);
 }
 
 void Context::getQueues() {
     graphicsQueue = device.getQueue(queueFamilyIndices.graphicsQueue.value(), 0);
     presnetQueue = device.getQueue(queueFamilyIndices.presentQueue.value(), 0);
+    transferQueue = queueFamilyIndices.transferQueue ? device.getQueue(queueFamilyIndices.transferQueue.value(), 0) : graphicsQueue;
+    computeQueue = queueFamilyIndices.computeQueue ? device.getQueue(queueFamilyIndices.computeQueue.value(), 0) : graphicsQueue;
 }
 
 void Context::queryQueueFamilyIndices(vk::SurfaceKHR surface) {
     auto properties = phyDevice.getQueueFamilyProperties();
     for (uint32_t i = 0; i < properties.size(); ++ i) {
-        const auto& properity = properties[i];
-        if (properity.queueFlags | vk::QueueFlagBits::eGraphics) {
+        auto flags = properties[i].queueFlags;
+        if (!queueFamilyIndices.graphicsQueue && (flags & vk::QueueFlagBits::eGraphics)) {
             queueFamilyIndices.graphicsQueue = i;
         }
 
-        if (phyDevice.getSurfaceSupportKHR(i, surface)) {
+        if (!queueFamilyIndices.presentQueue && phyDevice.getSurfaceSupportKHR(i, surface)) {
             queueFamilyIndices.presentQueue = i;
         }
 
-        if (queueFamilyIndices) {
-            break;
+        // Families without graphics run on their own hardware queues next to the graphics one
+        if (!queueFamilyIndices.transferQueue && (flags & vk::QueueFlagBits::eTransfer) &&
+            !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            queueFamilyIndices.transferQueue = i;
+        }
+
+        if (!queueFamilyIndices.computeQueue && (flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics)) {
+            queueFamilyIndices.computeQueue = i;
         }
     }
 }
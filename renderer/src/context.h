@@ -11,6 +11,9 @@
 #include "command_manager.h"
 #include "descriptor_manager.h"
 #include "texture.h"
+#include "memory_allocator.h"
+#include "staging_ring.h"
+#include "upload_queue.h"
 
 namespace huahualib {
 
@@ -19,6 +22,8 @@ public:
     struct QueueFamliyIndices {
         std::optional<uint32_t> graphicsQueue;
         std::optional<uint32_t> presentQueue;
+        std::optional<uint32_t> transferQueue;  // transfer only, the DMA engine
+        std::optional<uint32_t> computeQueue;   // compute without graphics, runs alongside rendering
 
         operator bool () const {
             return graphicsQueue.has_value() && presentQueue.has_value();
@@ -30,6 +35,8 @@ public:
     vk::Device device;              // Logical device
     vk::Queue graphicsQueue;        // graphics command queue
     vk::Queue presnetQueue;         // presnet command queue
+    vk::Queue transferQueue;        // dedicated transfer queue, the graphics queue when there is none
+    vk::Queue computeQueue;         // async compute queue, the graphics queue when there is none
     vk::SurfaceKHR surface;         // Surface
     std::unique_ptr<Swapchain> swapchainPtr;     // Swapchain
     std::unique_ptr<RenderProcess> renderProcessPtr;
@@ -37,8 +44,13 @@ public:
     std::unique_ptr<ShaderManager> shaderManagerPtr;
     std::unique_ptr<DescriptorManager> descriptorManagerPtr;
     std::unique_ptr<TextureManager> textureManagerPtr;
+    std::unique_ptr<MemoryAllocator> memoryAllocatorPtr;
+    std::unique_ptr<StagingRing> stagingRingPtr;
+    std::unique_ptr<UploadQueue> uploadQueuePtr;           // graphics queue, every upload finishes here
+    std::unique_ptr<UploadQueue> transferUploadQueuePtr;   // copies on the transfer queue, null without one
 
     QueueFamliyIndices queueFamilyIndices;
+    bool memoryBudget = false;      // VK_EXT_memory_budget is enabled
 
     ~Context();
 
@@ -54,7 +66,10 @@ public:
     void initGraphicsPipeline();
     void initCommandPool();
     void initDescriptorPool(uint32_t maxFlight);
-    void initTextureManager();
+    void initTextureManager(uint32_t maxFlight);
+    void initMemoryAllocator();
+    void initStagingRing();
+    void initUploadQueue();
 
 private:
     static Context* instance_;
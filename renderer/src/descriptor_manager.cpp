@@ -8,6 +8,7 @@ DescriptorManager::DescriptorManager(uint32_t maxFlight): maxFlight_(maxFlight)
 }
 
 DescriptorManager::~DescriptorManager() {
+    freeMaterialSets();
     Context::getInstance().device.destroyDescriptorPool(descriptorPool_);
 }
 
@@ -15,7 +16,7 @@ void DescriptorManager::createDescriporPool() {
     vk::DescriptorPoolCreateInfo poolInfo;
     std::vector<vk::DescriptorPoolSize> poolSizes(2);
     poolSizes[0]
-        .setType(vk::DescriptorType::eUniformBuffer)
+        .setType(vk::DescriptorType::eUniformBufferDynamic)
         .setDescriptorCount(maxFlight_);
     poolSizes[1]
         .setType(vk::DescriptorType::eCombinedImageSampler)
@@ -40,4 +41,37 @@ std::vector<vk::DescriptorSet> DescriptorManager::allocateDescriptorSets(const s
     return Context::getInstance().device.allocateDescriptorSets(allocInfo);
 }
 
+std::vector<vk::DescriptorSet> DescriptorManager::allocateMaterialSets(vk::DescriptorSetLayout layout, uint32_t count) {
+    freeMaterialSets();
+    if (count == 0) return {};
+
+    auto& device = Context::getInstance().device;
+    vk::DescriptorPoolSize poolSize;
+    poolSize
+        .setType(vk::DescriptorType::eCombinedImageSampler)
+        .setDescriptorCount(count);
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo
+        .setMaxSets(count)
+        .setPoolSizes(poolSize);
+
+    std::vector<vk::DescriptorSetLayout> layouts(count, layout);
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.setSetLayouts(layouts);
+    try {
+        materialPool_ = device.createDescriptorPool(poolInfo);
+        allocInfo.setDescriptorPool(materialPool_);
+        return device.allocateDescriptorSets(allocInfo);
+    } catch (const std::exception &e) {
+        freeMaterialSets();
+        throw std::runtime_error("Failed to allocate " + std::to_string(count) + " material descriptor sets!\n");
+    }
+}
+
+void DescriptorManager::freeMaterialSets() {
+    if (!materialPool_) return;
+    Context::getInstance().device.destroyDescriptorPool(materialPool_);
+    materialPool_ = nullptr;
+}
+
 }
\ No newline at end of file
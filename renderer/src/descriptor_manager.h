@@ -12,6 +12,11 @@ public:
     std::vector<vk::DescriptorSet> allocateDescriptorSets(const std::vector<vk::DescriptorSetLayout> &setLayouts);
     void freeDescriptorSets(std::vector<vk::DescriptorSet>& sets);
 
+    // count sets of a single combined image sampler, from a pool sized for exactly them.
+    // Replaces the previous material sets, which must no longer be in use.
+    std::vector<vk::DescriptorSet> allocateMaterialSets(vk::DescriptorSetLayout layout, uint32_t count);
+    void freeMaterialSets();
+
 private:
     struct SetInfo {
         vk::DescriptorPool pool;
@@ -20,6 +25,7 @@ private:
 
     uint32_t maxFlight_;
     vk::DescriptorPool descriptorPool_;
+    vk::DescriptorPool materialPool_;
 
     void createDescriporPool();
 };
@@ -0,0 +1,33 @@
+#include "frame_allocator.h"
+#include "context.h"
+
+namespace huahualib {
+
+FrameAllocator::FrameAllocator(uint32_t frameCount, vk::DeviceSize capacityPerFrame) {
+    auto& ctx = Context::getInstance();
+    alignment_ = std::max<vk::DeviceSize>(ctx.phyDevice.getProperties().limits.minUniformBufferOffsetAlignment, 16);
+    capacity_ = (capacityPerFrame + alignment_ - 1) / alignment_ * alignment_;
+    buffer_ = std::make_unique<Buffer>(capacity_ * frameCount,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+void FrameAllocator::beginFrame(uint32_t frame) {
+    frame_ = frame;
+    head_ = frame * capacity_;
+}
+
+FrameAllocator::Slice FrameAllocator::allocate(vk::DeviceSize size) {
+    auto end = (frame_ + 1) * capacity_;
+    if (head_ + size > end) {
+        throw std::runtime_error("Failed to allocate frame data, the frame's region is full!\n");
+    }
+    Slice slice;
+    slice.offset = (uint32_t)head_;
+    slice.map = static_cast<uint8_t*>(buffer_->map) + head_;
+    head_ = std::min(end, (head_ + size + alignment_ - 1) / alignment_ * alignment_);
+    return slice;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include "vulkan/vulkan.hpp"
+#include "buffer.h"
+
+namespace huahualib {
+
+// Bump allocator for per-frame uniform data. One persistently mapped buffer holds a region per frame
+// in flight, slices are aligned to minUniformBufferOffsetAlignment and bound through eUniformBufferDynamic
+// descriptors that all point at buffer(), the slice's offset is the dynamic offset.
+class FrameAllocator final {
+public:
+    struct Slice {
+        uint32_t offset;    // from the start of buffer(), the dynamic offset
+        void* map;
+    };
+
+    FrameAllocator(uint32_t frameCount, vk::DeviceSize capacityPerFrame = 1ull << 20);
+
+    // Starts handing out frame's region from its beginning, only once that frame's fence has signaled
+    void beginFrame(uint32_t frame);
+    // Throws when the frame's region is full
+    Slice allocate(vk::DeviceSize size);
+
+    template<typename T>
+    uint32_t push(const T& data) {
+        auto slice = allocate(sizeof(T));
+        memcpy(slice.map, &data, sizeof(T));
+        return slice.offset;
+    }
+
+    vk::Buffer buffer() const { return buffer_->buffer; }
+    vk::DeviceSize used() const { return head_ - frame_ * capacity_; }
+
+private:
+    std::unique_ptr<Buffer> buffer_;
+    vk::DeviceSize alignment_;
+    vk::DeviceSize capacity_;       // per frame, a multiple of alignment_
+    uint32_t frame_ = 0;
+    vk::DeviceSize head_ = 0;       // next free byte in the current frame's region
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+namespace huahualib {
+
+struct BoundingSphere final {
+    glm::vec3 center = glm::vec3(0.f);
+    float radius = 0.f;
+};
+
+struct BoundingBox final {
+    glm::vec3 min = glm::vec3(0.f);
+    glm::vec3 max = glm::vec3(0.f);
+};
+
+// View frustum as six planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them.
+// Planes are extracted in the space the matrix maps from, so passing proj * view * model gives object space planes.
+struct Frustum final {
+    glm::vec4 planes[6];
+
+    // Expects Vulkan clip space, depth in [0, 1]
+    static Frustum fromMatrix(const glm::mat4 &m) {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;    // left
+        frustum.planes[1] = row3 - row0;    // right
+        frustum.planes[2] = row3 + row1;    // bottom
+        frustum.planes[3] = row3 - row1;    // top
+        frustum.planes[4] = row2;           // near
+        frustum.planes[5] = row3 - row2;    // far
+        for (auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+
+    // Conservative, a box outside no single plane but outside the frustum still passes
+    bool intersectsBox(const BoundingBox &box) const {
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        glm::vec3 extent = (box.max - box.min) * 0.5f;
+        for (const auto& plane : planes) {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), extent)) return false;
+        }
+        return true;
+    }
+};
+
+}
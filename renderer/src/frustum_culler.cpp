@@ -0,0 +1,124 @@
+#include "frustum_culler.h"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HUAHUALIB_CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace huahualib {
+
+namespace {
+
+constexpr size_t kGroupSize = 4;
+constexpr size_t kParallelThreshold = 16384;    // boxes, below this one thread is faster
+constexpr size_t kGroupsPerTask = 1024;
+
+}
+
+void FrustumCuller::assign(std::span<const BoundingBox> boxes) {
+    count_ = boxes.size();
+    size_t padded = (count_ + kGroupSize - 1) / kGroupSize * kGroupSize;
+
+    // Padding boxes sit at the origin with no extent, their results are never written out
+    for (auto* lane : {&centerX_, &centerY_, &centerZ_, &extentX_, &extentY_, &extentZ_}) {
+        lane->assign(padded, 0.f);
+    }
+    for (size_t i = 0; i < count_; ++ i) {
+        glm::vec3 center = (boxes[i].min + boxes[i].max) * 0.5f;
+        glm::vec3 extent = (boxes[i].max - boxes[i].min) * 0.5f;
+        centerX_[i] = center.x;
+        centerY_[i] = center.y;
+        centerZ_[i] = center.z;
+        extentX_[i] = extent.x;
+        extentY_[i] = extent.y;
+        extentZ_[i] = extent.z;
+    }
+}
+
+size_t FrustumCuller::cull(const Frustum &frustum, std::span<uint8_t> visible) const {
+    return cullGroups(frustum, visible.data(), 0, (count_ + kGroupSize - 1) / kGroupSize);
+}
+
+size_t FrustumCuller::cull(const Frustum &frustum, std::span<uint8_t> visible, ThreadPool &pool) const {
+    if (count_ < kParallelThreshold || pool.size() < 2) {
+        return cull(frustum, visible);
+    }
+
+    size_t groupCount = (count_ + kGroupSize - 1) / kGroupSize;
+    size_t taskCount = (groupCount + kGroupsPerTask - 1) / kGroupsPerTask;
+    std::atomic<size_t> visibleCount = 0;
+    pool.parallelFor(taskCount, [&](size_t task) {
+        size_t firstGroup = task * kGroupsPerTask;
+        size_t endGroup = std::min(groupCount, firstGroup + kGroupsPerTask);
+        visibleCount += cullGroups(frustum, visible.data(), firstGroup, endGroup);
+    });
+    return visibleCount;
+}
+
+size_t FrustumCuller::cullGroups(const Frustum &frustum, uint8_t* visible, size_t firstGroup, size_t endGroup) const {
+    size_t visibleCount = 0;
+
+#ifdef HUAHUALIB_CULL_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; ++ p) {
+        const auto& plane = frustum.planes[p];
+        planeX[p] = _mm_set1_ps(plane.x);
+        planeY[p] = _mm_set1_ps(plane.y);
+        planeZ[p] = _mm_set1_ps(plane.z);
+        planeW[p] = _mm_set1_ps(plane.w);
+        absX[p] = _mm_set1_ps(std::abs(plane.x));
+        absY[p] = _mm_set1_ps(std::abs(plane.y));
+        absZ[p] = _mm_set1_ps(std::abs(plane.z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    for (size_t group = firstGroup; group < endGroup; ++ group) {
+        size_t base = group * kGroupSize;
+        __m128 cx = _mm_loadu_ps(&centerX_[base]);
+        __m128 cy = _mm_loadu_ps(&centerY_[base]);
+        __m128 cz = _mm_loadu_ps(&centerZ_[base]);
+        __m128 ex = _mm_loadu_ps(&extentX_[base]);
+        __m128 ey = _mm_loadu_ps(&extentY_[base]);
+        __m128 ez = _mm_loadu_ps(&extentZ_[base]);
+
+        // A box is outside a plane when its center is further behind it than its projected radius
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++ p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        size_t lanes = std::min(kGroupSize, count_ - base);
+        for (size_t lane = 0; lane < lanes; ++ lane) {
+            uint8_t inside = (outsideMask >> lane & 1) ? 0 : 1;
+            visible[base + lane] = inside;
+            visibleCount += inside;
+        }
+    }
+#else
+    size_t end = std::min(count_, endGroup * kGroupSize);
+    for (size_t i = firstGroup * kGroupSize; i < end; ++ i) {
+        uint8_t inside = 1;
+        for (const auto& plane : frustum.planes) {
+            float distance = plane.x * centerX_[i] + plane.y * centerY_[i] + plane.z * centerZ_[i] + plane.w;
+            float radius = std::abs(plane.x) * extentX_[i] + std::abs(plane.y) * extentY_[i] + std::abs(plane.z) * extentZ_[i];
+            if (distance + radius < 0.f) {
+                inside = 0;
+                break;
+            }
+        }
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+#endif
+
+    return visibleCount;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "frustum.h"
+#include "thread_pool.h"
+
+namespace huahualib {
+
+// Tests many boxes against a frustum. Boxes are kept as center/extent in structure-of-arrays
+// layout padded to groups of four, so one SSE iteration tests four boxes against a plane.
+class FrustumCuller final {
+public:
+    void assign(std::span<const BoundingBox> boxes);
+    size_t size() const { return count_; }
+
+    // Sets visible[i] to 1 when box i may intersect the frustum, 0 otherwise, and returns the visible count.
+    // visible must hold size() entries.
+    size_t cull(const Frustum &frustum, std::span<uint8_t> visible) const;
+    // Same, split across the pool once there are enough boxes to pay for the dispatch
+    size_t cull(const Frustum &frustum, std::span<uint8_t> visible, ThreadPool &pool) const;
+
+private:
+    size_t count_ = 0;
+    std::vector<float> centerX_, centerY_, centerZ_;
+    std::vector<float> extentX_, extentY_, extentZ_;
+
+    size_t cullGroups(const Frustum &frustum, uint8_t* visible, size_t firstGroup, size_t endGroup) const;
+};
+
+}
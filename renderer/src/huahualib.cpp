@@ -9,13 +9,16 @@ void init(const std::vector<const char*> &extensions, CreateSurfaceFunc func, in
     uint32_t maxFlight = 2;
     Context::init(extensions, func);
     auto& ctx = Context::getInstance();
+    ctx.initMemoryAllocator();
+    ctx.initUploadQueue();
+    ctx.initStagingRing();
     ctx.initCommandPool();
     ctx.initSwapchain(w, h);
     ctx.initShaderManager();
     ctx.initShaderModule();
     // ctx.initCommandPool();
     ctx.initDescriptorPool(maxFlight);
-    ctx.initTextureManager();
+    ctx.initTextureManager(maxFlight);
     ctx.initRenderProcess();
     ctx.initGraphicsPipeline();
     ctx.swapchainPtr->createFrameBuffers(w, h);
@@ -34,6 +37,10 @@ void quit() {
     ctx.descriptorManagerPtr.reset();
     ctx.shaderManagerPtr.reset();
     ctx.cmdManagerPtr.reset();
+    ctx.stagingRingPtr.reset();
+    ctx.uploadQueuePtr.reset();
+    ctx.transferUploadQueuePtr.reset();
+    ctx.memoryAllocatorPtr.reset();
     Context::quit();
 }
 
@@ -6,15 +6,15 @@ namespace huahualib {
 
 Image::Image(vk::ImageCreateInfo imageInfo, vk::ImageViewCreateInfo viewInfo, vk::MemoryPropertyFlags memProperty) {
     createImage(imageInfo);
-    allocateMemory(memProperty);
+    allocateMemory(memProperty, imageInfo.tiling == vk::ImageTiling::eLinear ? ResourceTiling::eLinear : ResourceTiling::eOptimal);
     createImageview(viewInfo);
 }
 
 Image::~Image() {
     auto& device = Context::getInstance().device;
     device.destroyImageView(view);
-    device.freeMemory(memory);
     device.destroyImage(image);
+    Context::getInstance().memoryAllocatorPtr->free(memory);
 }
 
 void Image::createImage(vk::ImageCreateInfo imageInfo) {
@@ -33,33 +33,14 @@ void Image::createImageview(vk::ImageViewCreateInfo viewInfo) {
     }
 }
 
-void Image::allocateMemory(vk::MemoryPropertyFlags memProperty) {
-    auto &device = Context::getInstance().device;
-    auto requirements = device.getImageMemoryRequirements(image);
-    vk::MemoryAllocateInfo allocInfo;
-
-    uint32_t index = 0;
-    auto properties = Context::getInstance().phyDevice.getMemoryProperties();
-    for (int i = 0; i < properties.memoryTypeCount; ++ i) {
-        if ((i << 1) & requirements.memoryTypeBits && properties.memoryTypes[i].propertyFlags & memProperty) {
-            index = i;
-        }
-    }
-
-    allocInfo
-        .setMemoryTypeIndex(index)
-        .setAllocationSize(requirements.size);
-
-    try {
-        memory = device.allocateMemory(allocInfo);
-    } catch (const std::exception &e) {
-        throw std::runtime_error("Failed to allocate image memory!\n");
-    }
-
-    device.bindImageMemory(image, memory, 0);
+void Image::allocateMemory(vk::MemoryPropertyFlags memProperty, ResourceTiling tiling) {
+    auto& ctx = Context::getInstance();
+    auto requirements = ctx.device.getImageMemoryRequirements(image);
+    memory = ctx.memoryAllocatorPtr->allocate(requirements, memProperty, {}, tiling);
+    ctx.device.bindImageMemory(image, memory.memory, memory.offset);
 }
 
-void Image::createImage(uint32_t w, uint32_t h, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::Image &image, vk::DeviceMemory &imageMem) {
+void Image::createImage(uint32_t w, uint32_t h, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::Image &image, MemoryAllocation &imageMem) {
     auto& device = Context::getInstance().device;
     vk::ImageCreateInfo imageInfo;
     imageInfo
@@ -70,6 +51,7 @@ void Image::createImage(uint32_t w, uint32_t h, vk::Format format, vk::ImageTili
         .setSamples(vk::SampleCountFlagBits::e1)
         .setExtent({w, h, 1})
         .setFormat(format)
+        .setTiling(tiling)
         .setUsage(usage);
 
     try {
@@ -79,26 +61,13 @@ void Image::createImage(uint32_t w, uint32_t h, vk::Format format, vk::ImageTili
     }
 
     auto memReq = device.getImageMemoryRequirements(image);
-    imageMem = allocateMemory(memReq.size, queryImageMemoryIndex(memReq.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal));
+    imageMem = Context::getInstance().memoryAllocatorPtr->allocate(memReq, vk::MemoryPropertyFlagBits::eDeviceLocal, {},
+        tiling == vk::ImageTiling::eLinear ? ResourceTiling::eLinear : ResourceTiling::eOptimal);
 
-    device.bindImageMemory(image, imageMem, 0);
+    device.bindImageMemory(image, imageMem.memory, imageMem.offset);
 }
 
 
-vk::DeviceMemory Image::allocateMemory(vk::DeviceSize size, uint32_t memTypeIndex) {
-    vk::DeviceMemory memory;
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo
-        .setAllocationSize(size)
-        .setMemoryTypeIndex(memTypeIndex);
-    try {
-        memory = Context::getInstance().device.allocateMemory(allocInfo);
-    } catch (const std::exception &e) {
-        throw std::runtime_error("Failed to allocate image memory!\n");
-    }
-    return memory;
-}
-
 vk::ImageView Image::createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags) {
     vk::ComponentMapping mapping;
     vk::ImageSubresourceRange range;
@@ -126,14 +95,4 @@ vk::ImageView Image::createImageView(vk::Image image, vk::Format format, vk::Ima
     return imageView;
 }
 
-uint32_t Image::queryImageMemoryIndex(size_t memTypeBits, vk::MemoryPropertyFlags memProperty) {
-    auto properties = Context::getInstance().phyDevice.getMemoryProperties();
-    for (int i = 0; i < properties.memoryTypeCount; ++ i) {
-        if ((i << 1) & memTypeBits && properties.memoryTypes[i].propertyFlags & memProperty) {
-            return i;
-        }
-    }
-    return 0;
-}
-
 }
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace huahualib {
+
+namespace {
+
+constexpr uint8_t kKtx2Identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Khronos data format descriptor constants for the formats written here
+constexpr uint8_t kDfdModelRgbsda = 1;
+constexpr uint8_t kDfdModelBC1A = 128;
+constexpr uint8_t kDfdModelBC3 = 130;
+constexpr uint8_t kDfdModelBC5 = 132;
+constexpr uint8_t kDfdModelBC7 = 134;
+constexpr uint8_t kDfdPrimariesBT709 = 1;
+constexpr uint8_t kDfdTransferLinear = 1;
+constexpr uint8_t kDfdTransferSrgb = 2;
+constexpr uint8_t kDfdChannelAlpha = 15;
+
+struct DfdSample {
+    uint16_t bitOffset;
+    uint8_t bitLength;      // minus one
+    uint8_t channelType;
+};
+
+bool isSrgb(vk::Format format) {
+    return format == vk::Format::eR8Srgb || format == vk::Format::eR8G8Srgb ||
+           format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc1RgbaSrgbBlock ||
+           format == vk::Format::eBc3SrgbBlock || format == vk::Format::eBc7SrgbBlock;
+}
+
+// One basic descriptor block, as required by the KTX2 spec
+std::vector<uint32_t> buildDfd(vk::Format format) {
+    uint32_t bytes, dim;
+    formatBlockInfo(format, bytes, dim);
+
+    uint8_t model = kDfdModelRgbsda;
+    std::vector<DfdSample> samples;
+    switch (format) {
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbSrgbBlock:
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc1RgbaSrgbBlock:
+            model = kDfdModelBC1A;
+            samples = {{0, 63, 0}};
+            break;
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc3SrgbBlock:
+            model = kDfdModelBC3;
+            samples = {{0, 63, kDfdChannelAlpha}, {64, 63, 0}};
+            break;
+        case vk::Format::eBc5UnormBlock:
+            model = kDfdModelBC5;
+            samples = {{0, 63, 0}, {64, 63, 1}};
+            break;
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            model = kDfdModelBC7;
+            samples = {{0, 127, 0}};
+            break;
+        case vk::Format::eR8Unorm:
+        case vk::Format::eR8Srgb:
+            samples = {{0, 7, 0}};
+            break;
+        case vk::Format::eR8G8Unorm:
+        case vk::Format::eR8G8Srgb:
+            samples = {{0, 7, 0}, {8, 7, 1}};
+            break;
+        default:
+            samples = {{0, 7, 0}, {8, 7, 1}, {16, 7, 2}, {24, 7, kDfdChannelAlpha}};
+            break;
+    }
+
+    uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+    std::vector<uint32_t> dfd;
+    dfd.push_back(4 + blockSize);                               // dfdTotalSize
+    dfd.push_back(0);                                           // vendorId, descriptorType
+    dfd.push_back(2 | blockSize << 16);                         // versionNumber, descriptorBlockSize
+    dfd.push_back(model | kDfdPrimariesBT709 << 8 | (isSrgb(format) ? kDfdTransferSrgb : kDfdTransferLinear) << 16);
+    dfd.push_back(dim > 1 ? (dim - 1) | (dim - 1) << 8 : 0);    // texelBlockDimension
+    dfd.push_back(bytes);                                       // bytesPlane0
+    dfd.push_back(0);
+    for (const auto& sample : samples) {
+        // Alpha stays linear in sRGB formats
+        uint8_t qualifiers = sample.channelType == kDfdChannelAlpha && isSrgb(format) ? 0x40 : 0;
+        dfd.push_back(sample.bitOffset | sample.bitLength << 16 | (uint32_t)(sample.channelType | qualifiers) << 24);
+        dfd.push_back(0);                                       // samplePosition
+        dfd.push_back(0);                                       // sampleLower
+        dfd.push_back(sample.bitLength == 7 ? 255 : 0xffffffffu);   // sampleUpper
+    }
+    return dfd;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void formatBlockInfo(vk::Format format, uint32_t &bytes, uint32_t &dim) {
+    switch (format) {
+        case vk::Format::eR8Unorm:
+        case vk::Format::eR8Srgb:
+            bytes = 1;
+            dim = 1;
+            return;
+        case vk::Format::eR8G8Unorm:
+        case vk::Format::eR8G8Srgb:
+            bytes = 2;
+            dim = 1;
+            return;
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+            bytes = 4;
+            dim = 1;
+            return;
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbSrgbBlock:
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc1RgbaSrgbBlock:
+            bytes = 8;
+            dim = 4;
+            return;
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc3SrgbBlock:
+        case vk::Format::eBc5UnormBlock:
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            bytes = 16;
+            dim = 4;
+            return;
+        default:
+            bytes = 0;
+            dim = 1;
+            return;
+    }
+}
+
+/*******************************************************
+*                       Ktx2File                       *
+*******************************************************/
+Ktx2File::Ktx2File(const std::string &filename): file_(filename) {
+    if (!file_.valid() || file_.size() < sizeof(Ktx2Header)) return;
+
+    Ktx2Header header;
+    memcpy(&header, file_.data(), sizeof(header));
+    if (memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+        header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0) {
+        return;
+    }
+
+    auto format = static_cast<vk::Format>(header.vkFormat);
+    uint32_t bytes, dim;
+    formatBlockInfo(format, bytes, dim);
+    if (bytes == 0) return;
+
+    // levelCount 0 asks the loader to generate mipmaps, only level 0 is stored then
+    uint32_t levelCount = std::max(1u, header.levelCount);
+    if (sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex) > file_.size()) return;
+
+    auto index = reinterpret_cast<const Ktx2LevelIndex*>(data() + sizeof(Ktx2Header));
+    std::vector<MipLevel> levels;
+    std::vector<size_t> sizes;
+    for (uint32_t i = 0; i < levelCount; ++ i) {
+        uint32_t w = std::max(1u, header.pixelWidth >> i);
+        uint32_t h = std::max(1u, header.pixelHeight >> i);
+        uint64_t expected = (uint64_t)((w + dim - 1) / dim) * ((h + dim - 1) / dim) * bytes;
+        if (index[i].byteLength != expected || index[i].byteOffset + index[i].byteLength > file_.size()) return;
+        levels.push_back({(size_t)index[i].byteOffset, w, h});
+        sizes.push_back((size_t)index[i].byteLength);
+    }
+
+    format_ = format;
+    width_ = header.pixelWidth;
+    height_ = header.pixelHeight;
+    levels_ = std::move(levels);
+    levelSizes_ = std::move(sizes);
+}
+
+bool Ktx2File::valid() const {
+    return !levels_.empty();
+}
+
+vk::Format Ktx2File::format() const {
+    return format_;
+}
+
+uint32_t Ktx2File::width() const {
+    return width_;
+}
+
+uint32_t Ktx2File::height() const {
+    return height_;
+}
+
+std::span<const MipLevel> Ktx2File::levels() const {
+    return levels_;
+}
+
+size_t Ktx2File::levelSize(uint32_t level) const {
+    return levelSizes_[level];
+}
+
+const uint8_t* Ktx2File::data() const {
+    return static_cast<const uint8_t*>(file_.data());
+}
+
+/*******************************************************
+*                       writeKtx2                      *
+*******************************************************/
+bool writeKtx2(const std::string &filename, vk::Format format, uint32_t w, uint32_t h, std::span<const std::vector<uint8_t>> levels) {
+    uint32_t bytes, dim;
+    formatBlockInfo(format, bytes, dim);
+    if (bytes == 0 || levels.empty()) return false;
+
+    auto dfd = buildDfd(format);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+    header.vkFormat = (uint32_t)format;
+    header.typeSize = 1;                // block compressed and 8 bit formats
+    header.pixelWidth = w;
+    header.pixelHeight = h;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t)levels.size();
+    header.dfdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+    // The spec stores the smallest level first, each aligned to the block size
+    std::vector<Ktx2LevelIndex> index(levels.size());
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (size_t i = levels.size(); i-- > 0;) {
+        offset = alignUp(offset, std::max(bytes, 4u));
+        index[i] = {offset, levels[i].size(), levels[i].size()};
+        offset += levels[i].size();
+    }
+
+    std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream file(tmpFilename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Write " << tmpFilename << " failed!" << std::endl;
+            return false;
+        }
+
+        const char padding[16] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(Ktx2LevelIndex));
+        file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+        for (size_t i = levels.size(); i-- > 0;) {
+            file.write(padding, index[i].byteOffset - (uint64_t)file.tellp());
+            file.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+        }
+
+        if (!file.good()) {
+            std::cout << "Write " << tmpFilename << " failed!" << std::endl;
+            return false;
+        }
+    }
+
+    std::remove(filename.c_str());
+    if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
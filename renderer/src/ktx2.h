@@ -0,0 +1,43 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "mapped_file.h"
+#include "mipmap.h"
+
+namespace huahualib {
+
+// Reader for single-image 2D KTX2 files without supercompression, the subset texture_compressor writes.
+// Supports BC1/BC3/BC5/BC7, R8, RG8 and RGBA8. Level data stays in the mapped file.
+class Ktx2File final {
+public:
+    Ktx2File(const std::string &filename);
+
+    bool valid() const;
+    vk::Format format() const;
+    uint32_t width() const;
+    uint32_t height() const;
+    // Level 0 first, offsets from the start of data()
+    std::span<const MipLevel> levels() const;
+    // Bytes of a level, as stored in the file
+    size_t levelSize(uint32_t level) const;
+    const uint8_t* data() const;
+
+private:
+    MappedFile file_;
+    vk::Format format_ = vk::Format::eUndefined;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    std::vector<MipLevel> levels_;
+    std::vector<size_t> levelSizes_;
+};
+
+// Bytes per block and block width in texels, 0 bytes for formats Ktx2File does not support
+void formatBlockInfo(vk::Format format, uint32_t &bytes, uint32_t &dim);
+
+// Writes a KTX2 file with the given levels, level 0 first. Levels must be tightly packed blocks of format.
+bool writeKtx2(const std::string &filename, vk::Format format, uint32_t w, uint32_t h, std::span<const std::vector<uint8_t>> levels);
+
+}
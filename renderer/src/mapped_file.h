@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+namespace huahualib {
+
+// Read-only memory mapping of a whole file.
+class MappedFile final {
+public:
+    MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const;
+    const void* data() const;
+    size_t size() const;
+
+private:
+    const void* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+
+    void unmap();
+};
+
+}
@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <bit>
+#include <set>
+#include <unordered_map>
+#include "memory_allocator.h"
+
+namespace huahualib {
+
+/*******************************************************
+*                  DeviceMemoryBackend                 *
+*******************************************************/
+
+DeviceMemoryBackend::DeviceMemoryBackend(vk::PhysicalDevice phyDevice, vk::Device device, bool memoryBudget): phyDevice_(phyDevice), device_(device), memoryBudget_(memoryBudget) {}
+
+vk::PhysicalDeviceMemoryProperties DeviceMemoryBackend::memoryProperties() const {
+    return phyDevice_.getMemoryProperties();
+}
+
+vk::DeviceSize DeviceMemoryBackend::bufferImageGranularity() const {
+    return phyDevice_.getProperties().limits.bufferImageGranularity;
+}
+
+vk::DeviceMemory DeviceMemoryBackend::allocate(vk::DeviceSize size, uint32_t memoryType) {
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo
+        .setAllocationSize(size)
+        .setMemoryTypeIndex(memoryType);
+    try {
+        return device_.allocateMemory(allocInfo);
+    } catch (const std::exception &e) {
+        return nullptr;
+    }
+}
+
+void DeviceMemoryBackend::free(vk::DeviceMemory memory) {
+    device_.freeMemory(memory);
+}
+
+void* DeviceMemoryBackend::map(vk::DeviceMemory memory) {
+    return device_.mapMemory(memory, 0, VK_WHOLE_SIZE);
+}
+
+void DeviceMemoryBackend::unmap(vk::DeviceMemory memory) {
+    device_.unmapMemory(memory);
+}
+
+std::vector<MemoryHeapBudget> DeviceMemoryBackend::heapBudgets() const {
+    if (!memoryBudget_) {
+        return {};
+    }
+    auto chain = phyDevice_.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    auto& properties = chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+    auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+    std::vector<MemoryHeapBudget> budgets(properties.memoryHeapCount);
+    for (uint32_t i = 0; i < properties.memoryHeapCount; ++ i) {
+        budgets[i].usage = budget.heapUsage[i];
+        budgets[i].budget = budget.heapBudget[i];
+    }
+    return budgets;
+}
+
+/*******************************************************
+*                      MemoryBlock                     *
+*******************************************************/
+
+// One device memory object split into buddy nodes. A node of order k is minNodeSize << k bytes
+// at an offset that is a multiple of its size, its buddy is at offset ^ size.
+struct MemoryBlock {
+    vk::DeviceMemory memory;
+    void* map = nullptr;
+    vk::DeviceSize size = 0;
+    vk::DeviceSize minNodeSize = 0;
+    uint32_t pool = 0;
+    std::vector<std::set<vk::DeviceSize>> freeNodes;            // per order, lowest offset first
+    std::unordered_map<vk::DeviceSize, uint32_t> usedNodes;     // offset -> order
+    vk::DeviceSize usedBytes = 0;
+
+    MemoryBlock(vk::DeviceSize size, vk::DeviceSize minNodeSize): size(size), minNodeSize(minNodeSize) {
+        uint32_t maxOrder = std::countr_zero(size / minNodeSize);
+        freeNodes.resize(maxOrder + 1);
+        freeNodes[maxOrder].insert(0);
+    }
+
+    bool allocate(uint32_t order, vk::DeviceSize &offset) {
+        uint32_t found = order;
+        while (found < freeNodes.size() && freeNodes[found].empty()) {
+            ++ found;
+        }
+        if (found == freeNodes.size()) {
+            return false;
+        }
+
+        offset = *freeNodes[found].begin();
+        freeNodes[found].erase(freeNodes[found].begin());
+        // Split down to the wanted order, the upper halves stay free
+        while (found > order) {
+            -- found;
+            freeNodes[found].insert(offset + (minNodeSize << found));
+        }
+        usedNodes[offset] = order;
+        return true;
+    }
+
+    void free(vk::DeviceSize offset) {
+        auto it = usedNodes.find(offset);
+        uint32_t order = it->second;
+        usedNodes.erase(it);
+
+        // Merge with the buddy as long as it is free
+        while (order + 1 < freeNodes.size()) {
+            vk::DeviceSize buddy = offset ^ (minNodeSize << order);
+            if (!freeNodes[order].erase(buddy)) {
+                break;
+            }
+            offset = std::min(offset, buddy);
+            ++ order;
+        }
+        freeNodes[order].insert(offset);
+    }
+};
+
+/*******************************************************
+*                    MemoryAllocator                   *
+*******************************************************/
+
+MemoryAllocator::MemoryAllocator(std::unique_ptr<MemoryBackend> backend, const MemoryAllocatorOptions &options): backend_(std::move(backend)), options_(options) {
+    properties_ = backend_->memoryProperties();
+    separateTiling_ = backend_->bufferImageGranularity() > 1;
+
+    pools_.resize(properties_.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < properties_.memoryTypeCount; ++ i) {
+        // Small heaps get smaller blocks so a single one doesn't take a large part of them
+        auto heapSize = properties_.memoryHeaps[properties_.memoryTypes[i].heapIndex].size;
+        auto size = std::min(options_.blockSize, std::bit_floor(std::max<vk::DeviceSize>(heapSize / 8, 1)));
+        size = std::max(size, options_.minNodeSize);
+        for (uint32_t tiling = 0; tiling < 2; ++ tiling) {
+            pools_[i * 2 + tiling].memoryType = i;
+            pools_[i * 2 + tiling].blockSize = size;
+        }
+    }
+
+    heapAllocated_.resize(properties_.memoryHeapCount, 0);
+    budgets_.resize(properties_.memoryHeapCount);
+    budgetAllocated_.resize(properties_.memoryHeapCount, 0);
+    for (uint32_t i = 0; i < properties_.memoryHeapCount; ++ i) {
+        budgets_[i].budget = properties_.memoryHeaps[i].size / 10 * 8;
+    }
+    updateBudget();
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (auto& pool : pools_) {
+        for (auto& block : pool.blocks) {
+            destroyBlock(*block);
+        }
+    }
+    for (auto& allocation : dedicated_) {
+        if (allocation.map) backend_->unmap(allocation.memory);
+        backend_->free(allocation.memory);
+    }
+}
+
+std::vector<uint32_t> MemoryAllocator::memoryTypeCandidates(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const {
+    // Protected and lazily allocated memory only when asked for, they can't back ordinary resources
+    vk::MemoryPropertyFlags special = vk::MemoryPropertyFlagBits::eProtected | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < properties_.memoryTypeCount; ++ i) {
+        auto flags = properties_.memoryTypes[i].propertyFlags;
+        if ((typeBits & (1u << i)) && (flags & required) == required && !(flags & special & ~required)) {
+            candidates.push_back(i);
+        }
+    }
+    // Most preferred flags first, the driver's order among equals
+    auto score = [&](uint32_t type) {
+        return std::popcount(static_cast<uint32_t>(properties_.memoryTypes[type].propertyFlags & preferred));
+    };
+    std::stable_sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) { return score(a) > score(b); });
+    return candidates;
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const {
+    auto candidates = memoryTypeCandidates(typeBits, required, preferred);
+    if (candidates.empty()) {
+        throw std::runtime_error("Failed to find a suitable memory type!\n");
+    }
+    return candidates.front();
+}
+
+vk::DeviceSize MemoryAllocator::blockSize(uint32_t memoryType) const {
+    return pools_[memoryType * 2].blockSize;
+}
+
+bool MemoryAllocator::hostVisible(uint32_t memoryType) const {
+    return bool(properties_.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+}
+
+void MemoryAllocator::updateBudget() {
+    auto budgets = backend_->heapBudgets();
+    std::lock_guard lock(mutex_);
+    if (budgets.size() == budgets_.size()) {
+        budgets_ = std::move(budgets);
+        budgetAllocated_ = heapAllocated_;
+    }
+}
+
+MemoryHeapBudget MemoryAllocator::heapBudget(uint32_t heap) const {
+    // Driver usage from the last update plus what was allocated or freed since
+    MemoryHeapBudget budget = budgets_[heap];
+    auto usage = (int64_t)budget.usage + (int64_t)heapAllocated_[heap] - (int64_t)budgetAllocated_[heap];
+    budget.usage = (vk::DeviceSize)std::max<int64_t>(usage, 0);
+    return budget;
+}
+
+bool MemoryAllocator::fitsBudget(uint32_t memoryType, vk::DeviceSize size) const {
+    auto budget = heapBudget(properties_.memoryTypes[memoryType].heapIndex);
+    return budget.usage + size <= budget.budget;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags required,
+                                           vk::MemoryPropertyFlags preferred, ResourceTiling tiling, bool dedicated) {
+    auto candidates = memoryTypeCandidates(requirements.memoryTypeBits, required, preferred);
+    if (candidates.empty()) {
+        throw std::runtime_error("Failed to find a suitable memory type!\n");
+    }
+
+    std::lock_guard lock(mutex_);
+    // Every type within its heap's budget first, then whatever the driver still hands out
+    for (bool withinBudget : {true, false}) {
+        for (auto memoryType : candidates) {
+            auto allocation = tryAllocate(requirements, memoryType, tiling, dedicated, withinBudget);
+            if (allocation) {
+                return allocation;
+            }
+        }
+    }
+    throw std::runtime_error("Failed to allocate device memory!\n");
+}
+
+MemoryAllocation MemoryAllocator::tryAllocate(const vk::MemoryRequirements &requirements, uint32_t memoryType,
+                                              ResourceTiling tiling, bool dedicated, bool withinBudget) {
+    uint32_t poolIndex = memoryType * 2 + (separateTiling_ ? (uint32_t)tiling : 0);
+    auto& pool = pools_[poolIndex];
+
+    auto nodeSize = std::bit_ceil(std::max({requirements.size, requirements.alignment, options_.minNodeSize}));
+    // The threshold in double, a float can't tell sizes of tens of MB apart to the byte
+    auto dedicatedSize = (vk::DeviceSize)((double)pool.blockSize * options_.dedicatedRatio);
+    if (dedicated || nodeSize > pool.blockSize || requirements.size > dedicatedSize) {
+        if (withinBudget && !fitsBudget(memoryType, requirements.size)) {
+            return {};
+        }
+        return allocateDedicated(requirements.size, memoryType);
+    }
+
+    uint32_t order = std::countr_zero(nodeSize / options_.minNodeSize);
+    vk::DeviceSize offset = 0;
+    MemoryBlock* block = nullptr;
+    for (auto& candidate : pool.blocks) {
+        if (candidate->allocate(order, offset)) {
+            block = candidate.get();
+            break;
+        }
+    }
+    if (!block) {
+        auto created = withinBudget && !fitsBudget(memoryType, pool.blockSize) ? nullptr : createBlock(poolIndex);
+        if (!created) {
+            // No room for another block, the resource alone may still fit
+            if (withinBudget && !fitsBudget(memoryType, requirements.size)) {
+                return {};
+            }
+            return allocateDedicated(requirements.size, memoryType);
+        }
+        created->allocate(order, offset);
+        block = created.get();
+        pool.blocks.push_back(std::move(created));
+    }
+    block->usedBytes += requirements.size;
+
+    MemoryAllocation allocation;
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.map = block->map ? static_cast<uint8_t*>(block->map) + offset : nullptr;
+    allocation.memoryType = memoryType;
+    allocation.block = block;
+    allocation.order = order;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation) {
+    if (!allocation) {
+        return;
+    }
+
+    std::lock_guard lock(mutex_);
+    if (!allocation.block) {
+        auto it = std::find_if(dedicated_.begin(), dedicated_.end(), [&](const MemoryAllocation &a) {
+            return a.memory == allocation.memory;
+        });
+        if (it != dedicated_.end()) {
+            if (it->map) backend_->unmap(it->memory);
+            backend_->free(it->memory);
+            heapAllocated_[properties_.memoryTypes[it->memoryType].heapIndex] -= it->size;
+            dedicated_.erase(it);
+        }
+        allocation = {};
+        return;
+    }
+
+    auto block = allocation.block;
+    block->free(allocation.offset);
+    block->usedBytes -= allocation.size;
+    allocation = {};
+
+    // Keep one empty block per pool so a freed and recreated resource doesn't reallocate device memory,
+    // this one only goes when another empty block stays behind
+    auto& pool = pools_[block->pool];
+    if (!block->usedNodes.empty()) {
+        return;
+    }
+    size_t emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto &b) { return b->usedNodes.empty(); });
+    if (emptyBlocks > 1) {
+        auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](const auto &b) { return b.get() == block; });
+        destroyBlock(*block);
+        pool.blocks.erase(it);
+    }
+}
+
+std::unique_ptr<MemoryBlock> MemoryAllocator::createBlock(uint32_t poolIndex) {
+    auto& pool = pools_[poolIndex];
+    auto memory = backend_->allocate(pool.blockSize, pool.memoryType);
+    if (!memory) {
+        return nullptr;
+    }
+    heapAllocated_[properties_.memoryTypes[pool.memoryType].heapIndex] += pool.blockSize;
+
+    auto block = std::make_unique<MemoryBlock>(pool.blockSize, options_.minNodeSize);
+    block->memory = memory;
+    block->pool = poolIndex;
+    if (hostVisible(pool.memoryType)) {
+        block->map = backend_->map(memory);
+    }
+    return block;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock &block) {
+    if (block.map) backend_->unmap(block.memory);
+    backend_->free(block.memory);
+    heapAllocated_[properties_.memoryTypes[pools_[block.pool].memoryType].heapIndex] -= block.size;
+}
+
+MemoryAllocation MemoryAllocator::allocateDedicated(vk::DeviceSize size, uint32_t memoryType) {
+    MemoryAllocation allocation;
+    allocation.memory = backend_->allocate(size, memoryType);
+    if (!allocation.memory) {
+        return {};
+    }
+    heapAllocated_[properties_.memoryTypes[memoryType].heapIndex] += size;
+
+    allocation.size = size;
+    allocation.memoryType = memoryType;
+    if (hostVisible(memoryType)) {
+        allocation.map = backend_->map(allocation.memory);
+    }
+    dedicated_.push_back(allocation);
+    return allocation;
+}
+
+MemoryStats MemoryAllocator::stats() const {
+    std::lock_guard lock(mutex_);
+    MemoryStats stats;
+    stats.heaps.resize(properties_.memoryHeapCount);
+    vk::DeviceSize largestPerBlock = 0;
+
+    for (uint32_t i = 0; i < properties_.memoryHeapCount; ++ i) {
+        auto budget = heapBudget(i);
+        stats.heaps[i].usage = budget.usage;
+        stats.heaps[i].budget = budget.budget;
+    }
+    for (const auto& pool : pools_) {
+        auto& heap = stats.heaps[properties_.memoryTypes[pool.memoryType].heapIndex];
+        for (const auto& block : pool.blocks) {
+            heap.allocatedBytes += block->size;
+            heap.usedBytes += block->usedBytes;
+            heap.memoryCount ++;
+            heap.allocationCount += (uint32_t)block->usedNodes.size();
+            stats.blockCount ++;
+            stats.allocationCount += (uint32_t)block->usedNodes.size();
+            vk::DeviceSize blockLargest = 0;
+            for (uint32_t order = 0; order < block->freeNodes.size(); ++ order) {
+                if (block->freeNodes[order].empty()) {
+                    continue;
+                }
+                auto nodeSize = block->minNodeSize << order;
+                stats.freeBytes += nodeSize * block->freeNodes[order].size();
+                blockLargest = nodeSize;
+            }
+            largestPerBlock += blockLargest;
+            stats.largestFree = std::max(stats.largestFree, blockLargest);
+        }
+    }
+    for (const auto& allocation : dedicated_) {
+        auto& heap = stats.heaps[properties_.memoryTypes[allocation.memoryType].heapIndex];
+        heap.allocatedBytes += allocation.size;
+        heap.usedBytes += allocation.size;
+        heap.memoryCount ++;
+        heap.allocationCount ++;
+        stats.dedicatedCount ++;
+        stats.allocationCount ++;
+    }
+    if (stats.freeBytes > 0) {
+        stats.fragmentation = 1.f - (float)largestPerBlock / (float)stats.freeBytes;
+    }
+    return stats;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace huahualib {
+
+struct MemoryHeapBudget {
+    vk::DeviceSize usage = 0;   // by the whole process, other allocators included
+    vk::DeviceSize budget = 0;  // how much the process can take before the driver starts paging
+};
+
+// What the allocator needs from the device, memory_allocator_benchmark replaces it with a fake memory table
+class MemoryBackend {
+public:
+    virtual ~MemoryBackend() = default;
+
+    virtual vk::PhysicalDeviceMemoryProperties memoryProperties() const = 0;
+    virtual vk::DeviceSize bufferImageGranularity() const = 0;
+    // Returns a null handle when the heap is out of memory
+    virtual vk::DeviceMemory allocate(vk::DeviceSize size, uint32_t memoryType) = 0;
+    virtual void free(vk::DeviceMemory memory) = 0;
+    virtual void* map(vk::DeviceMemory memory) = 0;
+    virtual void unmap(vk::DeviceMemory memory) = 0;
+    // One entry per heap, empty when the device can't report them
+    virtual std::vector<MemoryHeapBudget> heapBudgets() const { return {}; }
+};
+
+class DeviceMemoryBackend final : public MemoryBackend {
+public:
+    // memoryBudget: VK_EXT_memory_budget is enabled on the device
+    DeviceMemoryBackend(vk::PhysicalDevice phyDevice, vk::Device device, bool memoryBudget);
+
+    vk::PhysicalDeviceMemoryProperties memoryProperties() const override;
+    vk::DeviceSize bufferImageGranularity() const override;
+    vk::DeviceMemory allocate(vk::DeviceSize size, uint32_t memoryType) override;
+    void free(vk::DeviceMemory memory) override;
+    void* map(vk::DeviceMemory memory) override;
+    void unmap(vk::DeviceMemory memory) override;
+    std::vector<MemoryHeapBudget> heapBudgets() const override;
+
+private:
+    vk::PhysicalDevice phyDevice_;
+    vk::Device device_;
+    bool memoryBudget_;
+};
+
+// Buffers and linear images vs optimal images, the two may not share a bufferImageGranularity page
+enum class ResourceTiling : uint32_t {
+    eLinear,
+    eOptimal,
+};
+
+struct MemoryBlock;
+
+// Range of a device memory object to bind at offset. Host visible memory stays mapped
+// for its whole life, map already points at offset.
+struct MemoryAllocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    void* map = nullptr;
+    uint32_t memoryType = 0;
+
+    explicit operator bool() const { return bool(memory); }
+
+private:
+    friend class MemoryAllocator;
+    MemoryBlock* block = nullptr;   // null for dedicated allocations
+    uint32_t order = 0;             // buddy node is minNodeSize << order bytes
+};
+
+struct MemoryAllocatorOptions {
+    vk::DeviceSize blockSize = 64ull << 20;     // power of two, smaller on heaps under 8 blocks
+    vk::DeviceSize minNodeSize = 256;           // smallest buddy node, power of two
+    float dedicatedRatio = 0.5f;                // requests over this part of a block get their own memory
+};
+
+struct MemoryHeapStats {
+    vk::DeviceSize allocatedBytes = 0;  // device memory taken from the heap, blocks and dedicated
+    vk::DeviceSize usedBytes = 0;       // requested by live allocations
+    uint32_t memoryCount = 0;           // device memory objects
+    uint32_t allocationCount = 0;
+    vk::DeviceSize usage = 0;           // whole process, estimated from allocatedBytes without VK_EXT_memory_budget
+    vk::DeviceSize budget = 0;
+};
+
+struct MemoryStats {
+    std::vector<MemoryHeapStats> heaps;
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    vk::DeviceSize freeBytes = 0;       // unused inside blocks
+    vk::DeviceSize largestFree = 0;     // biggest node a block could still hand out
+    float fragmentation = 0.f;          // part of freeBytes outside the largest free node of its block
+};
+
+// Sub-allocates buffers and images from large blocks per memory type with a buddy scheme,
+// nodes are powers of two aligned to their size, so any alignment up to the node size holds.
+// Blocks never mix linear and optimal resources when the device reports a bufferImageGranularity.
+class MemoryAllocator final {
+public:
+    MemoryAllocator(std::unique_ptr<MemoryBackend> backend, const MemoryAllocatorOptions &options = {});
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // Takes the type with the most preferred flags among those with every required one. Types whose
+    // heap would go over budget are skipped as long as another one fits. Throws when nothing does.
+    MemoryAllocation allocate(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags required,
+                              vk::MemoryPropertyFlags preferred, ResourceTiling tiling, bool dedicated = false);
+    void free(MemoryAllocation &allocation);
+
+    uint32_t findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {}) const;
+    const vk::PhysicalDeviceMemoryProperties& memoryProperties() const { return properties_; }
+    vk::DeviceSize blockSize(uint32_t memoryType) const;
+
+    // Re-reads the driver's heap budgets, once per frame is enough. In between, the allocator's
+    // own allocations are added to the last usage. Without the extension the budget is 80% of the heap.
+    void updateBudget();
+    MemoryStats stats() const;
+
+private:
+    struct Pool {
+        uint32_t memoryType;
+        vk::DeviceSize blockSize;
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+    std::unique_ptr<MemoryBackend> backend_;
+    MemoryAllocatorOptions options_;
+    vk::PhysicalDeviceMemoryProperties properties_;
+    bool separateTiling_;
+    std::vector<Pool> pools_;       // [memoryType * 2 + tiling]
+    std::vector<MemoryAllocation> dedicated_;
+    std::vector<vk::DeviceSize> heapAllocated_;     // device memory taken by this allocator
+    std::vector<MemoryHeapBudget> budgets_;         // as of the last updateBudget()
+    std::vector<vk::DeviceSize> budgetAllocated_;   // heapAllocated_ at that time
+    mutable std::mutex mutex_;
+
+    std::vector<uint32_t> memoryTypeCandidates(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const;
+    MemoryAllocation tryAllocate(const vk::MemoryRequirements &requirements, uint32_t memoryType,
+                                 ResourceTiling tiling, bool dedicated, bool withinBudget);
+    std::unique_ptr<MemoryBlock> createBlock(uint32_t poolIndex);
+    void destroyBlock(MemoryBlock &block);
+    MemoryAllocation allocateDedicated(vk::DeviceSize size, uint32_t memoryType);
+    bool hostVisible(uint32_t memoryType) const;
+    MemoryHeapBudget heapBudget(uint32_t heap) const;
+    bool fitsBudget(uint32_t memoryType, vk::DeviceSize size) const;
+};
+
+}
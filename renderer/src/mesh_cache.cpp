@@ -0,0 +1,102 @@
+#include "mesh_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace huahualib {
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/*******************************************************
+*                       MeshCache                      *
+*******************************************************/
+MeshCache::MeshCache(const std::string &filename): file_(filename) {
+    if (!file_.valid() || file_.size() < sizeof(MeshCacheHeader)) return;
+
+    auto header = static_cast<const MeshCacheHeader*>(file_.data());
+    uint64_t tableEnd = sizeof(MeshCacheHeader) + uint64_t(header->sectionCount) * sizeof(MeshCacheSection);
+    if (header->magic != kMeshCacheMagic || tableEnd > file_.size()) return;
+
+    auto table = reinterpret_cast<const MeshCacheSection*>(header + 1);
+    for (uint32_t i = 0; i < header->sectionCount; ++ i) {
+        const auto& sec = table[i];
+        if (sec.offset % kMeshCacheAlignment != 0 || sec.offset + sec.size > file_.size() ||
+            sec.stride == 0 || sec.size % sec.stride != 0) {
+            return;
+        }
+    }
+
+    header_ = header;
+    sections_ = {table, header->sectionCount};
+}
+
+bool MeshCache::valid(uint64_t sourceHash, uint64_t sourceSize, uint32_t optionsKey) const {
+    return header_ &&
+           header_->version == kMeshCacheVersion &&
+           header_->sourceHash == sourceHash &&
+           header_->sourceSize == sourceSize &&
+           header_->optionsKey == optionsKey;
+}
+
+const MeshCacheSection* MeshCache::findSection(MeshCacheSectionType type) const {
+    for (const auto& sec : sections_) {
+        if (sec.type == type) return &sec;
+    }
+    return nullptr;
+}
+
+/*******************************************************
+*                    MeshCacheWriter                   *
+*******************************************************/
+bool MeshCacheWriter::save(const std::string &filename, uint64_t sourceHash, uint64_t sourceSize, uint32_t optionsKey) const {
+    MeshCacheHeader header = {};
+    header.magic = kMeshCacheMagic;
+    header.version = kMeshCacheVersion;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.sectionCount = (uint32_t)sections_.size();
+    header.optionsKey = optionsKey;
+
+    std::vector<MeshCacheSection> table(sections_.size());
+    uint64_t offset = sizeof(MeshCacheHeader) + table.size() * sizeof(MeshCacheSection);
+    for (size_t i = 0; i < sections_.size(); ++ i) {
+        offset = alignUp(offset, kMeshCacheAlignment);
+        table[i] = {sections_[i].type, sections_[i].stride, offset, sections_[i].size};
+        offset += sections_[i].size;
+    }
+
+    // Write into a temporary file first so that a crash never leaves a truncated cache behind
+    std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream file(tmpFilename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Write " << tmpFilename << " failed!" << std::endl;
+            return false;
+        }
+
+        const char padding[kMeshCacheAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(MeshCacheSection));
+        for (size_t i = 0; i < sections_.size(); ++ i) {
+            file.write(padding, table[i].offset - (uint64_t)file.tellp());
+            file.write(static_cast<const char*>(sections_[i].data), sections_[i].size);
+        }
+
+        if (!file.good()) {
+            std::cout << "Write " << tmpFilename << " failed!" << std::endl;
+            return false;
+        }
+    }
+
+    std::remove(filename.c_str());
+    if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+namespace huahualib {
+
+// Binary mesh cache (*.hmesh) layout:
+//   MeshCacheHeader
+//   MeshCacheSection[sectionCount]
+//   section payloads, each aligned to kMeshCacheAlignment
+// Payloads are stored exactly as they live in memory, so a mapped cache
+// can be handed to the renderer without any parsing or copying.
+constexpr uint32_t kMeshCacheMagic = 0x48534d48;    // "HMSH"
+constexpr uint32_t kMeshCacheVersion = 4;
+constexpr uint64_t kMeshCacheAlignment = 16;
+
+enum class MeshCacheSectionType : uint32_t {
+    eSubmeshes = 1,
+    eVertices = 2,
+    eIndices = 3,
+    eCompactVertices = 4,
+    eQuantization = 5,
+    eMeshlets = 6,
+    eMeshletVertices = 7,
+    eMeshletTriangles = 8,
+    eMeshletBounds = 9,
+    eLods = 10,
+    eLodSubmeshes = 11,
+    eMaterials = 12,
+};
+
+struct MeshCacheHeader final {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;    // hash of the source .obj and .mtl content
+    uint64_t sourceSize;    // size of the source .obj in bytes
+    uint32_t sectionCount;
+    uint32_t optionsKey;    // load options the data was built with
+};
+
+struct MeshCacheSection final {
+    MeshCacheSectionType type;
+    uint32_t stride;        // element size, checked against the reader's type
+    uint64_t offset;        // from the start of the file
+    uint64_t size;          // in bytes
+};
+
+struct MeshCacheSubmesh final {
+    uint64_t begin, end;
+    int32_t material;       // index into the material section, -1 for none
+    uint32_t reserved;
+};
+
+struct MeshCacheMaterial final {
+    char name[64];
+    char diffuseTexture[192];   // as written in the .mtl, relative to the mtl base dir
+    float diffuse[3];
+    uint32_t reserved;
+};
+
+class MeshCache final {
+public:
+    MeshCache(const std::string &filename);
+
+    // True when the file is a mapped cache of the current version built from the given source and options
+    bool valid(uint64_t sourceHash, uint64_t sourceSize, uint32_t optionsKey) const;
+
+    template<typename T>
+    std::span<const T> section(MeshCacheSectionType type) const {
+        auto sec = findSection(type);
+        if (!sec || sec->stride != sizeof(T)) return {};
+        auto base = static_cast<const char*>(file_.data()) + sec->offset;
+        return {reinterpret_cast<const T*>(base), size_t(sec->size / sizeof(T))};
+    }
+
+private:
+    MappedFile file_;
+    const MeshCacheHeader* header_ = nullptr;
+    std::span<const MeshCacheSection> sections_;
+
+    const MeshCacheSection* findSection(MeshCacheSectionType type) const;
+};
+
+class MeshCacheWriter final {
+public:
+    template<typename T>
+    void addSection(MeshCacheSectionType type, std::span<const T> data) {
+        sections_.push_back({type, sizeof(T), data.data(), data.size_bytes()});
+    }
+
+    bool save(const std::string &filename, uint64_t sourceHash, uint64_t sourceSize, uint32_t optionsKey) const;
+
+private:
+    struct PendingSection {
+        MeshCacheSectionType type;
+        uint32_t stride;
+        const void* data;
+        size_t size;
+    };
+
+    std::vector<PendingSection> sections_;
+};
+
+}
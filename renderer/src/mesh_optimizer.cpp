@@ -0,0 +1,253 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "triangle_adjacency.h"
+
+namespace huahualib {
+
+namespace {
+
+constexpr uint32_t kInvalid = 0xffffffffu;
+
+// Forsyth's scoring parameters, tuned for a 32 entry LRU cache
+constexpr int kForsythCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+float forsythVertexScore(int cachePos, uint32_t remaining) {
+    if (remaining == 0) return -1.f;
+
+    float score = 0.f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) {
+            // The last triangle's vertices get a fixed score so the next triangle doesn't just reuse them
+            score = kLastTriScore;
+        } else {
+            float scaler = 1.f / (kForsythCacheSize - 3);
+            score = std::pow(1.f - (cachePos - 3) * scaler, kCacheDecayPower);
+        }
+    }
+
+    // Boost vertices with few triangles left so they get finished off
+    score += kValenceBoostScale * std::pow((float)remaining, -kValenceBoostPower);
+    return score;
+}
+
+}
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats;
+    if (indices.size() < 3) return stats;
+
+    // FIFO cache, a vertex is resident when it was inserted less than cacheSize misses ago
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t time = cacheSize + 1;
+    uint32_t unique = 0;
+
+    for (auto index : indices) {
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            ++ stats.transformed;
+        }
+        if (!referenced[index]) {
+            referenced[index] = true;
+            ++ unique;
+        }
+    }
+
+    stats.acmr = (float)stats.transformed / (indices.size() / 3);
+    stats.atvr = unique ? (float)stats.transformed / unique : 0.f;
+    return stats;
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount) {
+    size_t triCount = indices.size() / 3;
+    if (triCount < 2) return;
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+    std::vector<uint32_t> remaining = adjacency.counts;
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++ i) {
+        vertexScore[i] = forsythVertexScore(-1, remaining[i]);
+    }
+
+    std::vector<float> triScore(triCount);
+    std::vector<bool> emitted(triCount, false);
+    for (size_t t = 0; t < triCount; ++ t) {
+        triScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+    }
+
+    std::vector<uint32_t> output(indices.size());
+    uint32_t cache[kForsythCacheSize + 3];
+    uint32_t newCache[kForsythCacheSize + 3];
+    int cacheCount = 0;
+
+    uint32_t best = (uint32_t)(std::max_element(triScore.begin(), triScore.end()) - triScore.begin());
+    size_t inputCursor = 0;
+
+    for (size_t out = 0; out < triCount; ++ out) {
+        if (best == kInvalid) {
+            // Nothing adjacent to the cache is left, continue from the next unused triangle in input order
+            while (emitted[inputCursor]) ++ inputCursor;
+            best = (uint32_t)inputCursor;
+        }
+
+        const uint32_t* tri = &indices[3 * best];
+        output[3 * out] = tri[0];
+        output[3 * out + 1] = tri[1];
+        output[3 * out + 2] = tri[2];
+        emitted[best] = true;
+
+        // Remove the triangle from its vertices' live adjacency
+        for (int k = 0; k < 3; ++ k) {
+            uint32_t v = tri[k];
+            uint32_t* list = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t count = remaining[v];
+            for (uint32_t j = 0; j < count; ++ j) {
+                if (list[j] == best) {
+                    std::swap(list[j], list[count - 1]);
+                    break;
+                }
+            }
+            -- remaining[v];
+        }
+
+        // Emitted vertices move to the front of the LRU cache
+        int newCount = 0;
+        newCache[newCount++] = tri[0];
+        newCache[newCount++] = tri[1];
+        newCache[newCount++] = tri[2];
+        for (int i = 0; i < cacheCount; ++ i) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+        for (int i = kForsythCacheSize; i < newCount; ++ i) {
+            cachePos[newCache[i]] = -1;
+            vertexScore[newCache[i]] = forsythVertexScore(-1, remaining[newCache[i]]);
+        }
+        cacheCount = std::min(newCount, kForsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        for (int i = 0; i < cacheCount; ++ i) {
+            cachePos[cache[i]] = i;
+            vertexScore[cache[i]] = forsythVertexScore(i, remaining[cache[i]]);
+        }
+
+        // Rescore triangles touching the cache and pick the best for the next step
+        best = kInvalid;
+        float bestScore = -1.f;
+        for (int i = 0; i < cacheCount; ++ i) {
+            uint32_t v = cache[i];
+            const uint32_t* list = &adjacency.triangles[adjacency.offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++ j) {
+                uint32_t t = list[j];
+                float score = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+                triScore[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, uint32_t cacheSize) {
+    size_t triCount = indices.size() / 3;
+    if (triCount < 2) return;
+
+    // 1. Split at hard boundaries, triangles whose three vertices all miss the cache.
+    //    Reordering whole clusters leaves the cache behaviour inside them untouched.
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = cacheSize + 1;
+    for (size_t t = 0; t < triCount; ++ t) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; ++ k) {
+            uint32_t v = indices[3 * t + k];
+            if (time - timestamps[v] > cacheSize) {
+                timestamps[v] = time++;
+                ++ misses;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters.push_back((uint32_t)t);
+        }
+    }
+    clusters.push_back((uint32_t)triCount);
+    size_t clusterCount = clusters.size() - 1;
+    if (clusterCount < 2) return;
+
+    // 2. Area weighted centroid and normal of every cluster
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.f));
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+    for (size_t c = 0; c < clusterCount; ++ c) {
+        float area = 0.f;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++ t) {
+            const glm::vec3& p0 = vertices[indices[3 * t]].pos;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].pos;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float triArea = glm::length(n);
+            centroids[c] += (p0 + p1 + p2) * (triArea / 3.f);
+            normals[c] += n;
+            area += triArea;
+        }
+        meshCentroid += centroids[c];
+        meshArea += area;
+        centroids[c] = area > 0.f ? centroids[c] / area : vertices[indices[3 * clusters[c]]].pos;
+    }
+    if (meshArea > 0.f) meshCentroid /= meshArea;
+
+    // 3. Clusters that face away from the mesh center occlude the rest, draw them first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++ c) {
+        float length = glm::length(normals[c]);
+        glm::vec3 n = length > 0.f ? normals[c] / length : glm::vec3(0.f);
+        sortKeys[c] = glm::dot(centroids[c] - meshCentroid, n);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (auto c : order) {
+        output.insert(output.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices) {
+    std::vector<uint32_t> remap(vertices.size(), kInvalid);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+
+    for (auto& index : indices) {
+        if (remap[index] == kInvalid) {
+            remap[index] = (uint32_t)output.size();
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(output);
+}
+
+}
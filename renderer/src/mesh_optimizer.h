@@ -0,0 +1,30 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+namespace huahualib {
+
+// Post-transform cache statistics from a FIFO cache simulation.
+// ACMR: transformed vertices per triangle (0.5 is ideal for regular meshes, 3 is worst).
+// ATVR: transformed vertices per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+    uint32_t transformed = 0;
+    float acmr = 0.f;
+    float atvr = 0.f;
+};
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorders triangles in place for post-transform cache locality (Forsyth's linear-speed algorithm)
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+// Reorders clusters of triangles so outward facing clusters are drawn first, reducing overdraw.
+// Clusters are split where the cache restarts, so run this after optimizeVertexCache().
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, uint32_t cacheSize = 16);
+
+// Moves vertices into first-use order, rewrites indices and drops unreferenced vertices
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices);
+
+}
@@ -0,0 +1,333 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_set>
+#include "triangle_adjacency.h"
+#include "vertex_weld.h"
+
+namespace huahualib {
+
+namespace {
+
+// Symmetric 4x4 quadric, stored as the upper triangle and divided by the accumulated area on evaluation
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    static Quadric fromPlane(const glm::dvec3 &n, double d, double w) {
+        Quadric q;
+        q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z; q.a03 = w * n.x * d;
+        q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a13 = w * n.y * d;
+        q.a22 = w * n.z * n.z; q.a23 = w * n.z * d;
+        q.a33 = w * d * d;
+        q.weight = w;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric &o) {
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+        a11 += o.a11; a12 += o.a12; a13 += o.a13;
+        a22 += o.a22; a23 += o.a23;
+        a33 += o.a33;
+        weight += o.weight;
+        return *this;
+    }
+
+    // Mean squared distance of p to the accumulated planes
+    double error(const glm::vec3 &p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z +
+                   2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                   2 * (a03 * x + a13 * y + a23 * z) + a33;
+        return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+enum class VertexKind : uint8_t {
+    eManifold,      // free to collapse onto any neighbour
+    eSeam,          // one of two wedges on an attribute seam, moves along the seam with its twin
+    eLocked,        // open borders, complex seams and non-manifold vertices
+};
+
+constexpr uint32_t kInvalid = 0xffffffffu;
+constexpr double kBorderWeight = 2.0;
+
+using EdgeSet = std::unordered_set<uint64_t>;
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t)a << 32 | b;
+}
+
+struct Collapse {
+    uint32_t from, to;
+    float cost;
+};
+
+uint32_t hashPosition(const glm::vec3 &p) {
+    uint32_t bits[3];
+    glm::vec3 folded = p + glm::vec3(0.f);    // fold -0 into +0
+    memcpy(bits, &folded, sizeof(bits));
+    return hashIndexTriple((int)bits[0], (int)bits[1], (int)bits[2]);
+}
+
+glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+}
+
+float simplifyMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices, size_t targetIndexCount,
+                   const SimplifyOptions &options, std::vector<uint32_t> &result) {
+    result.assign(indices.begin(), indices.end());
+    size_t vertexCount = vertices.size();
+    if (indices.size() <= targetIndexCount || vertexCount == 0) return 0.f;
+
+    // 1. Group vertices that share a position. Groups are circular lists through nextWedge,
+    //    more than one vertex in a group is an attribute seam.
+    std::vector<uint32_t> positionId(vertexCount);
+    std::vector<uint32_t> nextWedge(vertexCount);
+    std::vector<uint32_t> groupSize(vertexCount, 0);
+    WeldTable positions(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++ v) {
+        auto [id, inserted] = positions.findOrInsert(hashPosition(vertices[v].pos), v, [&](uint32_t k) {
+            return vertices[k].pos == vertices[v].pos;
+        });
+        positionId[v] = id;
+        nextWedge[v] = v;
+        if (!inserted) {
+            nextWedge[v] = nextWedge[id];
+            nextWedge[id] = v;
+        }
+        ++ groupSize[id];
+    }
+
+    // 2. Classify vertices by the open edges around their position
+    EdgeSet positionEdges;
+    positionEdges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; ++ k) {
+            positionEdges.insert(edgeKey(positionId[indices[i + k]], positionId[indices[i + (k + 1) % 3]]));
+        }
+    }
+
+    std::vector<uint32_t> openOut(vertexCount, 0), openIn(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; ++ k) {
+            uint32_t a = positionId[indices[i + k]], b = positionId[indices[i + (k + 1) % 3]];
+            if (!positionEdges.count(edgeKey(b, a))) {
+                ++ openOut[a];
+                ++ openIn[b];
+            }
+        }
+    }
+
+    std::vector<VertexKind> kinds(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++ v) {
+        uint32_t p = positionId[v];
+        bool open = openOut[p] > 0 || openIn[p] > 0;
+        // Open borders stay put, a submesh's border is shared with its neighbours
+        // and moving it on one side only would open cracks between them
+        if (groupSize[p] == 1) {
+            kinds[v] = !open ? VertexKind::eManifold : VertexKind::eLocked;
+        } else {
+            kinds[v] = groupSize[p] == 2 && !open ? VertexKind::eSeam : VertexKind::eLocked;
+        }
+    }
+
+    // 3. Area weighted plane quadrics per position, open edges also get a plane
+    //    perpendicular to their triangle so borders keep their shape
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::vec3 p[3] = {vertices[indices[i]].pos, vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos};
+        glm::dvec3 n = triangleNormal(p[0], p[1], p[2]);
+        double area = glm::length(n);
+        if (area == 0) continue;
+        n /= area;
+        auto q = Quadric::fromPlane(n, -glm::dot(n, glm::dvec3(p[0])), area * 0.5);
+        for (int k = 0; k < 3; ++ k) {
+            quadrics[positionId[indices[i + k]]] += q;
+        }
+
+        for (int k = 0; k < 3; ++ k) {
+            uint32_t a = positionId[indices[i + k]], b = positionId[indices[i + (k + 1) % 3]];
+            if (positionEdges.count(edgeKey(b, a))) continue;
+            glm::dvec3 edge = glm::dvec3(p[(k + 1) % 3]) - glm::dvec3(p[k]);
+            double length = glm::length(edge);
+            if (length == 0) continue;
+            glm::dvec3 side = glm::normalize(glm::cross(edge, n));
+            auto border = Quadric::fromPlane(side, -glm::dot(side, glm::dvec3(p[k])), length * length * kBorderWeight);
+            border.weight = 0;    // shape only, doesn't dilute the mean distance
+            quadrics[a] += border;
+            quadrics[b] += border;
+        }
+    }
+
+    float maxCost = options.targetError * options.targetError;
+    float resultError = 0.f;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    EdgeSet edges, currentPositionEdges;
+
+    auto cost = [&](uint32_t a, uint32_t b) {
+        Quadric q = quadrics[positionId[a]];
+        q += quadrics[positionId[b]];
+        const auto& va = vertices[a];
+        const auto& vb = vertices[b];
+        glm::vec3 edge = vb.pos - va.pos;
+        glm::vec2 duv = vb.texcoord - va.texcoord;
+        glm::vec3 dn = vb.normal - va.normal;
+        float attribute = (glm::dot(duv, duv) + 0.25f * glm::dot(dn, dn)) * glm::dot(edge, edge);
+        return (float)q.error(vb.pos) + options.attributeWeight * attribute;
+    };
+
+    // The wedge b' next to b that a's other wedge connects to across the seam
+    auto seamTarget = [&](uint32_t a, uint32_t b) -> uint32_t {
+        uint32_t other = nextWedge[a];
+        for (uint32_t w = nextWedge[b]; w != b; w = nextWedge[w]) {
+            if (edges.count(edgeKey(other, w)) || edges.count(edgeKey(w, other))) return w;
+        }
+        return kInvalid;
+    };
+
+    // 4. Collapse the cheapest edges in passes. Vertices around a collapse are frozen
+    //    for the rest of the pass, so every collapse sees up to date geometry.
+    while (result.size() > targetIndexCount) {
+        edges.clear();
+        currentPositionEdges.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++ k) {
+                uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                edges.insert(edgeKey(a, b));
+                currentPositionEdges.insert(edgeKey(positionId[a], positionId[b]));
+            }
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++ k) {
+                uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                for (int dir = 0; dir < 2; ++ dir, std::swap(a, b)) {
+                    bool allowed = false;
+                    uint32_t pa = positionId[a], pb = positionId[b];
+                    bool border = !currentPositionEdges.count(edgeKey(pb, pa)) || !currentPositionEdges.count(edgeKey(pa, pb));
+                    bool seam = !border && (!edges.count(edgeKey(b, a)) || !edges.count(edgeKey(a, b)));
+                    switch (kinds[a]) {
+                        case VertexKind::eManifold: allowed = true; break;
+                        case VertexKind::eSeam:     allowed = seam; break;      // slide along the seam
+                        case VertexKind::eLocked:   allowed = false; break;
+                    }
+                    if (!allowed) continue;
+
+                    float c = cost(a, b);
+                    if (c <= maxCost) {
+                        collapses.push_back({a, b, c});
+                    }
+                }
+            }
+        }
+        if (collapses.empty()) break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) {
+            return x.cost < y.cost;
+        });
+
+        TriangleAdjacency adjacency(result, vertexCount);
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removeGoal = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+
+        // Triangles around from that collapse with the move, or kInvalid when one would flip
+        auto collapsedTriangles = [&](uint32_t from, uint32_t to) -> uint32_t {
+            const uint32_t* list = &adjacency.triangles[adjacency.offsets[from]];
+            uint32_t collapsed = 0;
+            for (uint32_t j = 0; j < adjacency.counts[from]; ++ j) {
+                const uint32_t* tri = &result[3 * list[j]];
+                if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                    ++ collapsed;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; ++ k) {
+                    p[k] = vertices[tri[k]].pos;
+                    q[k] = tri[k] == from ? vertices[to].pos : p[k];
+                }
+                if (glm::dot(triangleNormal(p[0], p[1], p[2]), triangleNormal(q[0], q[1], q[2])) <= 0.f) {
+                    return kInvalid;
+                }
+            }
+            return collapsed;
+        };
+
+        auto touch = [&](uint32_t from) {
+            const uint32_t* list = &adjacency.triangles[adjacency.offsets[from]];
+            for (uint32_t j = 0; j < adjacency.counts[from]; ++ j) {
+                const uint32_t* tri = &result[3 * list[j]];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+        };
+
+        for (const auto& c : collapses) {
+            if (touched[c.from] || touched[c.to]) continue;
+
+            uint32_t collapsed = collapsedTriangles(c.from, c.to);
+            if (collapsed == kInvalid || collapsed == 0) continue;
+
+            // Both sides of a seam move together so the wedges stay at one position
+            uint32_t otherFrom = kInvalid, otherTo = kInvalid;
+            if (kinds[c.from] == VertexKind::eSeam) {
+                otherFrom = nextWedge[c.from];
+                otherTo = seamTarget(c.from, c.to);
+                if (otherTo == kInvalid || touched[otherFrom] || touched[otherTo]) continue;
+                uint32_t otherCollapsed = collapsedTriangles(otherFrom, otherTo);
+                if (otherCollapsed == kInvalid || otherCollapsed == 0) continue;
+                collapsed += otherCollapsed;
+            }
+
+            remap[c.from] = c.to;
+            touch(c.from);
+            if (otherFrom != kInvalid) {
+                remap[otherFrom] = otherTo;
+                touch(otherFrom);
+            }
+            quadrics[positionId[c.to]] += quadrics[positionId[c.from]];
+            resultError = std::max(resultError, c.cost);
+
+            removed += collapsed;
+            if (removed >= removeGoal) break;
+        }
+        if (removed == 0) break;
+
+        // Apply the pass and drop degenerate triangles
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return std::sqrt(resultError);
+}
+
+uint32_t selectLod(std::span<const MeshLod> lods, float distance, float projectionScale, float maxPixelError) {
+    uint32_t level = 0;
+    float scale = projectionScale / std::max(distance, 1e-4f);
+    for (uint32_t i = 1; i < lods.size(); ++ i) {
+        if (lods[i].error * scale > maxPixelError) break;
+        level = i;
+    }
+    return level;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+namespace huahualib {
+
+struct SimplifyOptions final {
+    float targetError = 0.01f;      // max deviation in object space units
+    float attributeWeight = 1.f;    // weight of normal/texcoord change against geometric error
+};
+
+// Quadric error edge collapse. Vertices only ever collapse onto other existing
+// vertices, so the result indexes the same vertex buffer. Vertices on open borders
+// are locked in place, so meshes simplified separately still meet. Attribute seams
+// (two vertices sharing a position) only collapse along the seam, both sides together.
+// Stops at targetIndexCount or when the next collapse would exceed the target
+// error, and returns the largest error introduced.
+float simplifyMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices, size_t targetIndexCount,
+                   const SimplifyOptions &options, std::vector<uint32_t> &result);
+
+// One level of detail of a whole model. The submeshes of a level are stored
+// back to back in the model's index buffer, so a level is a single index range.
+struct MeshLod final {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;                    // object space deviation from level 0
+};
+
+// Picks the coarsest level whose error, seen from distance, projects to at most maxPixelError pixels.
+// projectionScale is viewportHeight / (2 * tan(fovy / 2)).
+uint32_t selectLod(std::span<const MeshLod> lods, float distance, float projectionScale, float maxPixelError = 1.f);
+
+}
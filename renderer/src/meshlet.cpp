@@ -0,0 +1,182 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "triangle_adjacency.h"
+
+namespace huahualib {
+
+namespace {
+
+constexpr uint8_t kNotInMeshlet = 0xff;
+constexpr uint32_t kInvalid = 0xffffffffu;
+
+MeshletBounds computeBounds(const Meshlet &meshlet, const MeshletData &data, std::span<const Vertex> vertices) {
+    MeshletBounds bounds;
+    const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+    const uint8_t* meshletTriangles = &data.triangles[3 * meshlet.triangleOffset];
+
+    // Bounding sphere around the center of the AABB
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++ i) {
+        minPos = glm::min(minPos, vertices[meshletVertices[i]].pos);
+        maxPos = glm::max(maxPos, vertices[meshletVertices[i]].pos);
+    }
+    bounds.center = (minPos + maxPos) * 0.5f;
+    bounds.radius = 0.f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++ i) {
+        bounds.radius = std::max(bounds.radius, glm::length(vertices[meshletVertices[i]].pos - bounds.center));
+    }
+
+    // Normal cone, the axis is the average of the unit triangle normals
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> corners;
+    normals.reserve(meshlet.triangleCount);
+    corners.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++ t) {
+        const glm::vec3& p0 = vertices[meshletVertices[meshletTriangles[3 * t]]].pos;
+        const glm::vec3& p1 = vertices[meshletVertices[meshletTriangles[3 * t + 1]]].pos;
+        const glm::vec3& p2 = vertices[meshletVertices[meshletTriangles[3 * t + 2]]].pos;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        if (length == 0.f) continue;
+        normals.push_back(n / length);
+        corners.push_back(p0);
+        axis += normals.back();
+    }
+
+    bounds.coneApex = bounds.center;
+    bounds.coneAxis = glm::vec3(0.f, 0.f, 1.f);
+    bounds.coneCutoff = 1.f;
+
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.f) return bounds;
+    axis /= axisLength;
+
+    float minDot = 1.f;
+    for (const auto& n : normals) {
+        minDot = std::min(minDot, glm::dot(axis, n));
+    }
+    // A cone wider than a hemisphere can never be entirely back-facing
+    if (minDot <= 0.f) return bounds;
+
+    // Move the apex back along the axis until it is behind every triangle's plane
+    float maxT = 0.f;
+    for (size_t i = 0; i < normals.size(); ++ i) {
+        float t = glm::dot(bounds.center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+        maxT = std::max(maxT, t);
+    }
+
+    bounds.coneApex = bounds.center - axis * maxT;
+    bounds.coneAxis = axis;
+    bounds.coneCutoff = std::sqrt(1.f - minDot * minDot);
+    return bounds;
+}
+
+}
+
+void buildMeshlets(std::span<uint32_t> indices, std::span<const Vertex> vertices, const MeshletLimits &limits, MeshletData &data) {
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0) return;
+
+    uint32_t maxVertices = std::clamp<uint32_t>(limits.maxVertices, 3, 256);
+    uint32_t maxTriangles = std::max<uint32_t>(limits.maxTriangles, 1);
+
+    TriangleAdjacency adjacency(indices, vertices.size());
+    std::vector<uint8_t> localIndex(vertices.size(), kNotInMeshlet);
+    std::vector<bool> emitted(triCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t triangleBase = (uint32_t)(data.triangles.size() / 3);
+    Meshlet current = {(uint32_t)data.vertices.size(), triangleBase, 0, 0};
+    size_t inputCursor = 0;
+
+    auto flush = [&]() {
+        if (current.triangleCount == 0) return;
+        for (uint32_t i = 0; i < current.vertexCount; ++ i) {
+            localIndex[data.vertices[current.vertexOffset + i]] = kNotInMeshlet;
+        }
+        data.meshlets.push_back(current);
+        data.bounds.push_back(computeBounds(current, data, vertices));
+        current = {(uint32_t)data.vertices.size(), current.triangleOffset + current.triangleCount, 0, 0};
+    };
+
+    auto newVertexCount = [&](uint32_t t) {
+        return (uint32_t)(localIndex[indices[3 * t]] == kNotInMeshlet) +
+               (uint32_t)(localIndex[indices[3 * t + 1]] == kNotInMeshlet) +
+               (uint32_t)(localIndex[indices[3 * t + 2]] == kNotInMeshlet);
+    };
+
+    for (size_t emittedCount = 0; emittedCount < triCount; ++ emittedCount) {
+        // Prefer the unemitted neighbour that adds the fewest new vertices
+        uint32_t best = kInvalid;
+        uint32_t bestNew = 4;
+        for (uint32_t i = 0; i < current.vertexCount && bestNew > 0; ++ i) {
+            uint32_t v = data.vertices[current.vertexOffset + i];
+            const uint32_t* list = &adjacency.triangles[adjacency.offsets[v]];
+            for (uint32_t j = 0; j < adjacency.counts[v]; ++ j) {
+                uint32_t t = list[j];
+                if (emitted[t]) continue;
+                uint32_t extra = newVertexCount(t);
+                if (extra < bestNew || (extra == bestNew && t < best)) {
+                    best = t;
+                    bestNew = extra;
+                }
+            }
+        }
+
+        // Nothing connected is left, restart from the input order
+        if (best == kInvalid) {
+            while (emitted[inputCursor]) ++ inputCursor;
+            best = (uint32_t)inputCursor;
+            bestNew = newVertexCount(best);
+        }
+
+        if (current.vertexCount + bestNew > maxVertices || current.triangleCount + 1 > maxTriangles) {
+            flush();
+        }
+
+        for (int k = 0; k < 3; ++ k) {
+            uint32_t v = indices[3 * best + k];
+            if (localIndex[v] == kNotInMeshlet) {
+                localIndex[v] = (uint8_t)current.vertexCount++;
+                data.vertices.push_back(v);
+            }
+            data.triangles.push_back(localIndex[v]);
+            output.push_back(v);
+        }
+        ++ current.triangleCount;
+        emitted[best] = true;
+    }
+    flush();
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+MeshletStats analyzeMeshlets(const MeshletData &data, const MeshletLimits &limits, size_t vertexCount) {
+    MeshletStats stats;
+    stats.meshletCount = (uint32_t)data.meshlets.size();
+    if (stats.meshletCount == 0) return stats;
+
+    stats.avgVertices = (float)data.vertices.size() / stats.meshletCount;
+    stats.avgTriangles = (float)(data.triangles.size() / 3) / stats.meshletCount;
+    stats.vertexFill = stats.avgVertices / limits.maxVertices;
+    stats.triangleFill = stats.avgTriangles / limits.maxTriangles;
+
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t unique = 0;
+    for (auto v : data.vertices) {
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++ unique;
+        }
+    }
+    stats.vertexDuplication = unique ? (float)data.vertices.size() / unique : 0.f;
+    return stats;
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "frustum.h"
+#include "vertex.h"
+
+namespace huahualib {
+
+struct MeshletLimits final {
+    uint32_t maxVertices = 64;      // at most 256, local indices are 8-bit
+    uint32_t maxTriangles = 124;
+};
+
+// A cluster of triangles sharing a small vertex set. Its triangles are stored
+// as 8-bit indices into its slice of MeshletData::vertices, and the builder
+// also rewrites the source index buffer into meshlet order, so a meshlet is the
+// contiguous index range [3 * triangleOffset, 3 * (triangleOffset + triangleCount)).
+struct Meshlet final {
+    uint32_t vertexOffset;      // into MeshletData::vertices
+    uint32_t triangleOffset;    // into MeshletData::triangles (3 bytes each) and the index buffer
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// Object space bounds used for culling. The normal cone contains every triangle
+// normal, the meshlet is back-facing for any viewer inside the cone with
+// apex coneApex around -coneAxis. coneCutoff is 1 when the cone can't cull.
+struct MeshletBounds final {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneApex;
+    float coneCutoff;           // sine of the cone's half angle
+    glm::vec3 coneAxis;
+};
+
+struct MeshletData final {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+    std::vector<MeshletBounds> bounds;
+};
+
+struct MeshletStats final {
+    uint32_t meshletCount = 0;
+    float avgVertices = 0.f;
+    float avgTriangles = 0.f;
+    float vertexFill = 0.f;         // avgVertices / maxVertices
+    float triangleFill = 0.f;       // avgTriangles / maxTriangles
+    float vertexDuplication = 0.f;  // meshlet vertices per referenced vertex
+};
+
+// Greedily grows meshlets over adjacent triangles and appends them to data,
+// then rewrites indices into meshlet order. Call it for consecutive ranges of
+// one index buffer so that Meshlet::triangleOffset indexes the whole buffer.
+void buildMeshlets(std::span<uint32_t> indices, std::span<const Vertex> vertices, const MeshletLimits &limits, MeshletData &data);
+
+MeshletStats analyzeMeshlets(const MeshletData &data, const MeshletLimits &limits, size_t vertexCount);
+
+// cameraPos is in the meshlet's object space
+inline bool meshletBackfacing(const MeshletBounds &bounds, const glm::vec3 &cameraPos) {
+    glm::vec3 view = bounds.coneApex - cameraPos;
+    float length = glm::length(view);
+    return length > 0.f && glm::dot(view, bounds.coneAxis) > bounds.coneCutoff * length;
+}
+
+inline bool meshletVisible(const MeshletBounds &bounds, const Frustum &frustum, const glm::vec3 &cameraPos) {
+    return frustum.intersectsSphere(bounds.center, bounds.radius) && !meshletBackfacing(bounds, cameraPos);
+}
+
+}
@@ -0,0 +1,124 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HUAHUALIB_MIPMAP_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace huahualib {
+
+namespace {
+
+constexpr int kEncodeTableSize = 4096;
+
+struct SrgbTables {
+    std::array<float, 256> toLinear;
+    std::array<uint8_t, kEncodeTableSize + 1> fromLinear;     // indexed by linear * kEncodeTableSize
+
+    SrgbTables() {
+        for (int i = 0; i < 256; ++ i) {
+            float c = i / 255.f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i <= kEncodeTableSize; ++ i) {
+            float c = (float)i / kEncodeTableSize;
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            fromLinear[i] = (uint8_t)std::clamp((int)std::lround(s * 255.f), 0, 255);
+        }
+    }
+};
+
+const SrgbTables& srgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+// 1 is gray, 2 gray and alpha, 4 RGBA
+inline uint32_t colorChannels(uint32_t channels) {
+    return channels >= 3 ? 3 : 1;
+}
+
+// Linear values of one texel padded to 4, alpha in [0, 1]
+inline void decodeTexel(const uint8_t* texel, uint32_t channels, bool srgb, float* out) {
+    const auto& tables = srgbTables();
+    uint32_t colors = colorChannels(channels);
+    for (uint32_t c = 0; c < 4; ++ c) {
+        out[c] = c >= channels ? 0.f : srgb && c < colors ? tables.toLinear[texel[c]] : texel[c] / 255.f;
+    }
+}
+
+inline void encodeTexel(const float* in, uint32_t channels, bool srgb, uint8_t* texel) {
+    const auto& tables = srgbTables();
+    uint32_t colors = colorChannels(channels);
+    for (uint32_t c = 0; c < channels; ++ c) {
+        texel[c] = srgb && c < colors ? tables.fromLinear[(int)(in[c] * kEncodeTableSize + 0.5f)] : (uint8_t)(in[c] * 255.f + 0.5f);
+    }
+}
+
+void downsample(const uint8_t* src, uint32_t sw, uint32_t sh, uint8_t* dst, uint32_t dw, uint32_t dh, uint32_t channels, bool srgb) {
+    // One decoded row pair at a time, so every source texel is converted to linear once
+    std::vector<float> rows(2 * 4 * (size_t)sw);
+    for (uint32_t y = 0; y < dh; ++ y) {
+        uint32_t y0 = std::min(2 * y, sh - 1), y1 = std::min(2 * y + 1, sh - 1);
+        for (uint32_t x = 0; x < sw; ++ x) {
+            decodeTexel(src + channels * ((size_t)y0 * sw + x), channels, srgb, &rows[4 * x]);
+            decodeTexel(src + channels * ((size_t)y1 * sw + x), channels, srgb, &rows[4 * (sw + x)]);
+        }
+
+        for (uint32_t x = 0; x < dw; ++ x) {
+            uint32_t x0 = std::min(2 * x, sw - 1), x1 = std::min(2 * x + 1, sw - 1);
+            alignas(16) float sum[4];
+#ifdef HUAHUALIB_MIPMAP_SSE
+            __m128 s = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&rows[4 * x0]), _mm_loadu_ps(&rows[4 * x1])),
+                                  _mm_add_ps(_mm_loadu_ps(&rows[4 * (sw + x0)]), _mm_loadu_ps(&rows[4 * (sw + x1)])));
+            _mm_store_ps(sum, _mm_mul_ps(s, _mm_set1_ps(0.25f)));
+#else
+            for (int c = 0; c < 4; ++ c) {
+                sum[c] = (rows[4 * x0 + c] + rows[4 * x1 + c] + rows[4 * (sw + x0) + c] + rows[4 * (sw + x1) + c]) * 0.25f;
+            }
+#endif
+            encodeTexel(sum, channels, srgb, dst + channels * ((size_t)y * dw + x));
+        }
+    }
+}
+
+}
+
+uint32_t mipLevelCount(uint32_t w, uint32_t h) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(w, h); size > 1; size >>= 1) {
+        ++ levels;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> buildMipChain(const uint8_t* rgba, uint32_t w, uint32_t h, bool srgb, std::vector<uint8_t> &out) {
+    return buildMipChain(rgba, w, h, 4, srgb, out);
+}
+
+std::vector<MipLevel> buildMipChain(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, bool srgb, std::vector<uint8_t> &out) {
+    std::vector<MipLevel> levels;
+    size_t total = 0;
+    for (uint32_t lw = w, lh = h, i = 0, count = mipLevelCount(w, h); i < count; ++ i) {
+        levels.push_back({total, lw, lh});
+        total += channels * (size_t)lw * lh;
+        lw = std::max(1u, lw / 2);
+        lh = std::max(1u, lh / 2);
+    }
+
+    out.resize(total);
+    memcpy(out.data(), pixels, channels * (size_t)w * h);
+    for (size_t i = 1; i < levels.size(); ++ i) {
+        const auto& src = levels[i - 1];
+        const auto& dst = levels[i];
+        downsample(out.data() + src.offset, src.width, src.height, out.data() + dst.offset, dst.width, dst.height, channels, srgb);
+    }
+    return levels;
+}
+
+}
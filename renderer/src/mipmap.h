@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace huahualib {
+
+struct MipLevel final {
+    size_t offset;      // in bytes, from the start of the chain
+    uint32_t width;
+    uint32_t height;
+};
+
+// Levels of a full chain down to 1x1
+uint32_t mipLevelCount(uint32_t w, uint32_t h);
+
+// Builds the full mip chain of an RGBA8 image into out, level 0 first, tightly packed.
+// Each level is a 2x2 box filter of the previous one. Sizes round down like Vulkan's mip sizes,
+// so an odd last row or column only contributes to the level below while it is the only one.
+// With srgb the color channels are averaged in linear space, alpha is always averaged as is.
+std::vector<MipLevel> buildMipChain(const uint8_t* rgba, uint32_t w, uint32_t h, bool srgb, std::vector<uint8_t> &out);
+// Same for 8-bit images of 1 (gray), 2 (gray and alpha) or 4 channels
+std::vector<MipLevel> buildMipChain(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, bool srgb, std::vector<uint8_t> &out);
+
+}
@@ -1,14 +1,21 @@
 #include "model.h"
+#include "obj_parser.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 #include <iostream>
-#include <unordered_map>
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+#include "tool.h"
+#include "vertex_quantize.h"
+#include "vertex_weld.h"
 
 namespace huahualib {
 
-Model::Model(const std::string &objFilename, const std::string &mtlBasedir) {
+Model::Model(const std::string &objFilename, const std::string &mtlBasedir, const ModelLoadOptions &options): options_(options) {
     load(objFilename, mtlBasedir);
 }
 
@@ -16,20 +23,551 @@ Model::~Model() {
 
 }
 
-std::vector<Vertex>& Model::vertices() {
-    return vertices_;
+std::span<const Vertex> Model::vertices() const {
+    return vertexView_;
 }
 
-std::vector<uint32_t>& Model::indices() {
-    return indices_;
+std::span<const uint32_t> Model::indices() const {
+    return indexView_;
+}
+
+std::span<const MeshCacheSubmesh> Model::submeshes() const {
+    return submodel_;
+}
+
+std::span<const ModelMaterial> Model::materials() const {
+    return materials_;
+}
+
+std::span<const CompactVertex> Model::compactVertices() const {
+    return compactView_;
+}
+
+const VertexQuantization& Model::quantization() const {
+    return quantization_;
+}
+
+const MeshletData& Model::meshlets() const {
+    return meshlets_;
+}
+
+std::span<const MeshLod> Model::lods() const {
+    return lods_;
+}
+
+std::span<const MeshCacheSubmesh> Model::lodSubmeshes(uint32_t level) const {
+    size_t count = submodel_.size();
+    if (level >= lods_.size()) return {};
+    return std::span<const MeshCacheSubmesh>(lodSubmodel_).subspan(level * count, count);
+}
+
+const BoundingSphere& Model::bounds() const {
+    return bounds_;
+}
+
+std::span<const BoundingBox> Model::submeshBoxes() const {
+    return submeshBoxes_;
+}
+
+std::span<const BoundingSphere> Model::submeshSpheres() const {
+    return submeshSpheres_;
+}
+
+const TextureAtlas& Model::atlas() const {
+    return atlas_;
+}
+
+static std::string materialPath(const std::string &mtlBasedir, const std::string &texname) {
+    if (texname.empty() || mtlBasedir.empty()) return texname;
+    char last = mtlBasedir.back();
+    return last == '/' || last == '\\' ? mtlBasedir + texname : mtlBasedir + "/" + texname;
+}
+
+// Every name after an mtllib statement, found without parsing the rest of the file
+static std::vector<std::string> mtlLibraries(std::string_view text) {
+    std::vector<std::string> names;
+    constexpr std::string_view keyword = "mtllib";
+    for (size_t pos = text.find(keyword); pos != std::string_view::npos; pos = text.find(keyword, pos + keyword.size())) {
+        size_t lineStart = pos;
+        while (lineStart > 0 && (text[lineStart - 1] == ' ' || text[lineStart - 1] == '\t')) -- lineStart;
+        size_t args = pos + keyword.size();
+        if ((lineStart > 0 && text[lineStart - 1] != '\n') || args >= text.size() || (text[args] != ' ' && text[args] != '\t')) {
+            continue;
+        }
+
+        size_t lineEnd = std::min(text.find_first_of("\r\n", args), text.size());
+        while (args < lineEnd) {
+            size_t nameBegin = text.find_first_not_of(" \t", args);
+            if (nameBegin >= lineEnd) break;
+            size_t nameEnd = std::min(text.find_first_of(" \t\r\n", nameBegin), lineEnd);
+            names.emplace_back(text.substr(nameBegin, nameEnd - nameBegin));
+            args = nameEnd;
+        }
+    }
+    return names;
 }
 
 void Model::load(const std::string &objFilename, const std::string &mtlBasedir) {
+    // The source is only hashed here, straight from its mapping, parsing happens on a cache miss.
+    // The .mtl files it names go into the hash too, the cache holds their material table.
+    uint64_t sourceHash, sourceSize;
+    {
+        MappedFile source(objFilename);
+        sourceHash = hashBytes(source.data(), source.size());
+        sourceSize = source.size();
+        for (const auto& library : mtlLibraries({static_cast<const char*>(source.data()), source.size()})) {
+            MappedFile mtl(materialPath(mtlBasedir, library));
+            uint64_t mtlSize = mtl.size();
+            sourceHash = hashBytes(&mtlSize, sizeof(mtlSize), sourceHash);
+            sourceHash = hashBytes(mtl.data(), mtl.size(), sourceHash);
+        }
+    }
+
+    std::string cacheFilename = objFilename + ".hmesh";
+    if (loadCache(cacheFilename, mtlBasedir, sourceHash, sourceSize)) {
+        computeBounds();
+        buildAtlas();
+        std::cout << "Load Model " + objFilename + " from cache successed!" << std::endl;
+        return;
+    }
+
+    loadObj(objFilename, mtlBasedir);
+    optimize();
+    vertexView_ = vertices_;
+    indexView_ = indices_;
+    computeBounds();
+    buildLods();
+    if (options_.vertexFormat == VertexFormat::eCompact) {
+        quantization_ = quantizeVertices(vertices_, compactVertices_);
+    }
+    indexView_ = indices_;      // buildLods() appends to indices_
+    compactView_ = compactVertices_;
+    saveCache(cacheFilename, sourceHash, sourceSize);
+    buildAtlas();   // the cache keeps the original texcoords
+}
+
+bool Model::loadCache(const std::string &cacheFilename, const std::string &mtlBasedir, uint64_t sourceHash, uint64_t sourceSize) {
+    auto cache = std::make_unique<MeshCache>(cacheFilename);
+    if (!cache->valid(sourceHash, sourceSize, options_.key())) {
+        return false;
+    }
+
+    auto submeshes = cache->section<MeshCacheSubmesh>(MeshCacheSectionType::eSubmeshes);
+    auto vertices = cache->section<Vertex>(MeshCacheSectionType::eVertices);
+    auto indices = cache->section<uint32_t>(MeshCacheSectionType::eIndices);
+    if (vertices.empty() || indices.empty()) {
+        return false;
+    }
+
+    if (options_.vertexFormat == VertexFormat::eCompact) {
+        auto compact = cache->section<CompactVertex>(MeshCacheSectionType::eCompactVertices);
+        auto quantization = cache->section<VertexQuantization>(MeshCacheSectionType::eQuantization);
+        if (compact.size() != vertices.size() || quantization.size() != 1) {
+            return false;
+        }
+        compactView_ = compact;
+        quantization_ = quantization[0];
+    }
+
+    if (options_.buildMeshlets) {
+        auto meshlets = cache->section<Meshlet>(MeshCacheSectionType::eMeshlets);
+        auto meshletVertices = cache->section<uint32_t>(MeshCacheSectionType::eMeshletVertices);
+        auto meshletTriangles = cache->section<uint8_t>(MeshCacheSectionType::eMeshletTriangles);
+        auto meshletBounds = cache->section<MeshletBounds>(MeshCacheSectionType::eMeshletBounds);
+        if (meshlets.empty() || meshlets.size() != meshletBounds.size()) {
+            return false;
+        }
+        meshlets_.meshlets.assign(meshlets.begin(), meshlets.end());
+        meshlets_.vertices.assign(meshletVertices.begin(), meshletVertices.end());
+        meshlets_.triangles.assign(meshletTriangles.begin(), meshletTriangles.end());
+        meshlets_.bounds.assign(meshletBounds.begin(), meshletBounds.end());
+    }
+
+    if (options_.lodCount > 0) {
+        auto lods = cache->section<MeshLod>(MeshCacheSectionType::eLods);
+        auto lodSubmeshes = cache->section<MeshCacheSubmesh>(MeshCacheSectionType::eLodSubmeshes);
+        if (lods.empty() || lodSubmeshes.size() != lods.size() * submeshes.size()) {
+            return false;
+        }
+        lods_.assign(lods.begin(), lods.end());
+        lodSubmodel_.assign(lodSubmeshes.begin(), lodSubmeshes.end());
+    }
+
+    // Strings are stored NUL padded in fixed size records
+    auto materials = cache->section<MeshCacheMaterial>(MeshCacheSectionType::eMaterials);
+    for (const auto& record : materials) {
+        ModelMaterial material;
+        material.name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+        material.diffuseTexture = materialPath(mtlBasedir, std::string(record.diffuseTexture, strnlen(record.diffuseTexture, sizeof(record.diffuseTexture))));
+        material.diffuse = {record.diffuse[0], record.diffuse[1], record.diffuse[2]};
+        materials_.push_back(std::move(material));
+    }
+
+    submodel_.assign(submeshes.begin(), submeshes.end());
+    vertexView_ = vertices;
+    indexView_ = indices;
+    cache_ = std::move(cache);
+    return true;
+}
+
+void Model::saveCache(const std::string &cacheFilename, uint64_t sourceHash, uint64_t sourceSize) const {
+    std::vector<MeshCacheMaterial> materials(materials_.size());
+    for (size_t i = 0; i < materials_.size(); ++ i) {
+        const auto& name = materials_[i].name;
+        const auto& texname = materialTexnames_[i];
+        if (name.size() > sizeof(materials[i].name) || texname.size() > sizeof(materials[i].diffuseTexture)) {
+            std::cout << "Material " + name + " doesn't fit the mesh cache, not saved!" << std::endl;
+            return;
+        }
+        materials[i] = {};
+        memcpy(materials[i].name, name.data(), name.size());
+        memcpy(materials[i].diffuseTexture, texname.data(), texname.size());
+        materials[i].diffuse[0] = materials_[i].diffuse.r;
+        materials[i].diffuse[1] = materials_[i].diffuse.g;
+        materials[i].diffuse[2] = materials_[i].diffuse.b;
+    }
+
+    MeshCacheWriter writer;
+    writer.addSection(MeshCacheSectionType::eSubmeshes, std::span<const MeshCacheSubmesh>(submodel_));
+    writer.addSection(MeshCacheSectionType::eMaterials, std::span<const MeshCacheMaterial>(materials));
+    writer.addSection(MeshCacheSectionType::eVertices, vertexView_);
+    writer.addSection(MeshCacheSectionType::eIndices, indexView_);
+    if (options_.vertexFormat == VertexFormat::eCompact) {
+        writer.addSection(MeshCacheSectionType::eCompactVertices, compactView_);
+        writer.addSection(MeshCacheSectionType::eQuantization, std::span<const VertexQuantization>(&quantization_, 1));
+    }
+    if (options_.buildMeshlets) {
+        writer.addSection(MeshCacheSectionType::eMeshlets, std::span<const Meshlet>(meshlets_.meshlets));
+        writer.addSection(MeshCacheSectionType::eMeshletVertices, std::span<const uint32_t>(meshlets_.vertices));
+        writer.addSection(MeshCacheSectionType::eMeshletTriangles, std::span<const uint8_t>(meshlets_.triangles));
+        writer.addSection(MeshCacheSectionType::eMeshletBounds, std::span<const MeshletBounds>(meshlets_.bounds));
+    }
+    if (options_.lodCount > 0) {
+        writer.addSection(MeshCacheSectionType::eLods, std::span<const MeshLod>(lods_));
+        writer.addSection(MeshCacheSectionType::eLodSubmeshes, std::span<const MeshCacheSubmesh>(lodSubmodel_));
+    }
+    if (!writer.save(cacheFilename, sourceHash, sourceSize, options_.key())) {
+        std::cout << "Save mesh cache " + cacheFilename + " failed!" << std::endl;
+    }
+}
+
+// A submesh renumbered to the vertices it references, so the per submesh passes cost its own size
+// instead of the whole model's. remap has one kUnmapped entry per model vertex and is left that way.
+struct LocalSubmesh {
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> globals;      // model vertex of every local one
+    std::vector<Vertex> vertices;
+};
+
+static constexpr uint32_t kUnmapped = 0xffffffffu;
+
+static void localizeSubmesh(std::span<const uint32_t> submesh, std::span<const Vertex> vertices,
+                            std::vector<uint32_t> &remap, LocalSubmesh &local) {
+    local.indices.resize(submesh.size());
+    local.globals.clear();
+    local.vertices.clear();
+    for (size_t i = 0; i < submesh.size(); ++ i) {
+        auto& slot = remap[submesh[i]];
+        if (slot == kUnmapped) {
+            slot = (uint32_t)local.globals.size();
+            local.globals.push_back(submesh[i]);
+            local.vertices.push_back(vertices[submesh[i]]);
+        }
+        local.indices[i] = slot;
+    }
+    for (auto v : local.globals) {
+        remap[v] = kUnmapped;
+    }
+}
+
+void Model::optimize() {
+    if (!options_.optimizeVertexCache && !options_.optimizeOverdraw && !options_.optimizeVertexFetch && !options_.buildMeshlets) {
+        return;
+    }
+
+    auto before = analyzeVertexCache(indices_, vertices_.size());
+
+    // Triangles never move between submeshes, so each range is reordered on its own
+    std::vector<uint32_t> remap(vertices_.size(), kUnmapped);
+    LocalSubmesh local;
+    if (options_.optimizeVertexCache || options_.optimizeOverdraw) {
+        for (const auto& range : submodel_) {
+            if (range.end + 1 <= range.begin) continue;    // empty submesh
+            std::span<uint32_t> submesh(indices_.data() + range.begin, range.end - range.begin + 1);
+            localizeSubmesh(submesh, vertices_, remap, local);
+            if (options_.optimizeVertexCache) {
+                optimizeVertexCache(local.indices, local.globals.size());
+            }
+            if (options_.optimizeOverdraw) {
+                optimizeOverdraw(local.indices, local.vertices);
+            }
+            for (size_t i = 0; i < submesh.size(); ++ i) {
+                submesh[i] = local.globals[local.indices[i]];
+            }
+        }
+    }
+
+    if (options_.optimizeVertexFetch) {
+        optimizeVertexFetch(vertices_, indices_);
+    }
+
+    // Built last since it needs the final vertex numbering. The submeshes are
+    // consecutive, so meshlet triangle offsets index the whole index buffer.
+    if (options_.buildMeshlets) {
+        MeshletLimits limits;
+        for (const auto& range : submodel_) {
+            if (range.end + 1 <= range.begin) continue;    // empty submesh
+            std::span<uint32_t> submesh(indices_.data() + range.begin, range.end - range.begin + 1);
+            localizeSubmesh(submesh, vertices_, remap, local);
+            size_t firstVertex = meshlets_.vertices.size();
+            buildMeshlets(local.indices, local.vertices, limits, meshlets_);
+            for (size_t i = 0; i < submesh.size(); ++ i) {
+                submesh[i] = local.globals[local.indices[i]];
+            }
+            for (size_t i = firstVertex; i < meshlets_.vertices.size(); ++ i) {
+                meshlets_.vertices[i] = local.globals[meshlets_.vertices[i]];
+            }
+        }
+
+        auto stats = analyzeMeshlets(meshlets_, limits, vertices_.size());
+        std::cout << "Build meshlets: " << stats.meshletCount << " meshlets, "
+                  << stats.avgVertices << " vertices (" << stats.vertexFill * 100.f << "% fill), "
+                  << stats.avgTriangles << " triangles (" << stats.triangleFill * 100.f << "% fill)" << std::endl;
+    }
+
+    auto after = analyzeVertexCache(indices_, vertices_.size());
+    std::cout << "Optimize Model: ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+void Model::computeBounds() {
+    if (vertexView_.empty()) return;
+
+    glm::vec3 minPos = vertexView_[0].pos, maxPos = vertexView_[0].pos;
+    for (const auto& v : vertexView_) {
+        minPos = glm::min(minPos, v.pos);
+        maxPos = glm::max(maxPos, v.pos);
+    }
+    bounds_.center = (minPos + maxPos) * 0.5f;
+    bounds_.radius = 0.f;
+    for (const auto& v : vertexView_) {
+        bounds_.radius = std::max(bounds_.radius, glm::length(v.pos - bounds_.center));
+    }
+
+    // Per submesh from the vertices its level 0 triangles reference, simplified levels stay inside them
+    submeshBoxes_.assign(submodel_.size(), {});
+    submeshSpheres_.assign(submodel_.size(), {});
+    for (size_t i = 0; i < submodel_.size(); ++ i) {
+        const auto& range = submodel_[i];
+        if (range.end + 1 <= range.begin) continue;
+        auto indices = indexView_.subspan(range.begin, range.end - range.begin + 1);
+
+        BoundingBox box = {vertexView_[indices[0]].pos, vertexView_[indices[0]].pos};
+        for (auto index : indices) {
+            box.min = glm::min(box.min, vertexView_[index].pos);
+            box.max = glm::max(box.max, vertexView_[index].pos);
+        }
+        BoundingSphere sphere = {(box.min + box.max) * 0.5f, 0.f};
+        for (auto index : indices) {
+            sphere.radius = std::max(sphere.radius, glm::length(vertexView_[index].pos - sphere.center));
+        }
+        submeshBoxes_[i] = box;
+        submeshSpheres_[i] = sphere;
+    }
+}
+
+void Model::buildAtlas() {
+    if (options_.atlasMaxSize == 0) return;
+    atlas_ = TextureAtlas(options_.atlasPageSize);
+
+    // Candidates are per texture path, materials sharing a texture share its region
+    std::vector<std::string> paths;
+    std::vector<int32_t> materialPath(materials_.size(), -1);
+    for (size_t i = 0; i < materials_.size(); ++ i) {
+        const auto& path = materials_[i].diffuseTexture;
+        if (path.empty()) continue;
+        auto it = std::find(paths.begin(), paths.end(), path);
+        materialPath[i] = (int32_t)(it - paths.begin());
+        if (it == paths.end()) paths.push_back(path);
+    }
+    if (paths.empty()) return;
+
+    // A vertex can only be remapped into one region. Textures sampled outside [0, 1] repeat and
+    // cannot be packed, neither can two textures that share a vertex.
+    std::vector<uint8_t> packable(paths.size(), 1);
+    std::vector<int32_t> vertexPath(vertexView_.size(), -1);
+    auto visit = [&](std::span<const VerticesRange> ranges) {
+        for (const auto& range : ranges) {
+            if (range.material < 0 || range.end + 1 <= range.begin) continue;
+            int32_t path = materialPath[range.material];
+            if (path < 0) continue;
+            for (auto index : indexView_.subspan(range.begin, range.end - range.begin + 1)) {
+                const auto& uv = vertexView_[index].texcoord;
+                if (uv.x < 0.f || uv.x > 1.f || uv.y < 0.f || uv.y > 1.f) {
+                    packable[path] = 0;
+                }
+                auto& owner = vertexPath[index];
+                if (owner < 0) {
+                    owner = path;
+                } else if (owner != path) {
+                    packable[owner] = 0;
+                    packable[path] = 0;
+                }
+            }
+        }
+    };
+    visit(submodel_);
+    visit(lodSubmodel_);
+
+    // Decoded in parallel, larger images keep their own texture
+    struct Image {
+        stbi_uc* pixels = nullptr;
+        int w = 0, h = 0;
+    };
+    std::vector<Image> images(paths.size());
+    ThreadPool::instance().parallelFor(paths.size(), [&](size_t i) {
+        if (!packable[i]) return;
+        int channel;
+        auto& image = images[i];
+        image.pixels = stbi_load(paths[i].c_str(), &image.w, &image.h, &channel, STBI_rgb_alpha);
+        if (image.pixels && (uint32_t)std::max(image.w, image.h) > options_.atlasMaxSize) {
+            stbi_image_free(image.pixels);
+            image.pixels = nullptr;
+        }
+    });
+
+    // Tallest first packs the skyline tighter
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < paths.size(); ++ i) {
+        if (images[i].pixels) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return images[a].h != images[b].h ? images[a].h > images[b].h : images[a].w > images[b].w;
+    });
+    std::vector<std::optional<AtlasRegion>> regions(paths.size());
+    for (auto i : order) {
+        regions[i] = atlas_.add(images[i].pixels, (uint32_t)images[i].w, (uint32_t)images[i].h);
+        stbi_image_free(images[i].pixels);
+    }
+    if (atlas_.pages().empty()) return;
+
+    for (size_t i = 0; i < materials_.size(); ++ i) {
+        if (materialPath[i] >= 0 && regions[materialPath[i]]) {
+            materials_[i].atlasPage = (int32_t)regions[materialPath[i]]->page;
+        }
+    }
+
+    // Cached vertices are mapped read only, remapping needs a copy
+    if (vertexView_.data() != vertices_.data()) {
+        vertices_.assign(vertexView_.begin(), vertexView_.end());
+        vertexView_ = vertices_;
+    }
+    if (!compactView_.empty() && compactView_.data() != compactVertices_.data()) {
+        compactVertices_.assign(compactView_.begin(), compactView_.end());
+        compactView_ = compactVertices_;
+    }
+    for (size_t i = 0; i < vertices_.size(); ++ i) {
+        if (vertexPath[i] < 0 || !regions[vertexPath[i]]) continue;
+        const auto& region = *regions[vertexPath[i]];
+        vertices_[i].texcoord = vertices_[i].texcoord * region.scale + region.offset;
+    }
+    // Remapped UVs can leave the original bounds, so all of them are requantized
+    if (!compactVertices_.empty()) {
+        quantizeTexcoords(vertices_, compactVertices_, quantization_);
+    }
+}
+
+void Model::buildLods() {
+    uint32_t levelCount = std::min(options_.lodCount, 15u);
+    if (levelCount == 0) return;
+
+    // Level 0 is the mesh as loaded, meshlets keep indexing it
+    lods_.push_back({0, (uint32_t)indices_.size(), 0.f});
+    lodSubmodel_ = submodel_;
+
+    SimplifyOptions simplify;
+    simplify.targetError = options_.lodTargetError * bounds_.radius;
+
+    std::vector<uint32_t> lodIndices;
+    std::vector<uint32_t> remap(vertices_.size(), kUnmapped);
+    LocalSubmesh local;
+    for (uint32_t level = 1; level <= levelCount; ++ level) {
+        float ratio = std::pow(options_.lodReduction, (float)level);
+        MeshLod lod = {(uint32_t)indices_.size(), 0, lods_.back().error};
+
+        // Every level is simplified from level 0 so errors don't accumulate
+        for (const auto& range : submodel_) {
+            uint64_t begin = indices_.size();
+            if (range.end + 1 > range.begin) {
+                std::span<const uint32_t> submesh(indices_.data() + range.begin, range.end - range.begin + 1);
+                localizeSubmesh(submesh, vertices_, remap, local);
+                size_t target = (size_t)(submesh.size() / 3 * ratio) * 3;
+                float error = simplifyMesh(local.indices, local.vertices, target, simplify, lodIndices);
+                lod.error = std::max(lod.error, error);
+                if (options_.optimizeVertexCache) {
+                    optimizeVertexCache(lodIndices, local.globals.size());
+                }
+                for (auto index : lodIndices) {
+                    indices_.push_back(local.globals[index]);
+                }
+            }
+            lodSubmodel_.push_back({begin, indices_.size() - 1, range.material, 0});
+        }
+        lod.indexCount = (uint32_t)(indices_.size() - lod.indexOffset);
+
+        // Stop once the error bound keeps the simplifier from making progress
+        if (lod.indexCount > lods_.back().indexCount * 0.9f) {
+            indices_.resize(lod.indexOffset);
+            lodSubmodel_.resize(lods_.size() * submodel_.size());
+            break;
+        }
+        lods_.push_back(lod);
+    }
+
+    std::cout << "Build LODs:";
+    for (const auto& lod : lods_) {
+        std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+    }
+    std::cout << std::endl;
+}
+
+Vertex Model::makeVertex(const tinyobj::attrib_t &attrib, const tinyobj::index_t &index) {
+    Vertex v = {};
+
+    // Position
+    v.pos = {
+        attrib.vertices[3 * index.vertex_index],
+        attrib.vertices[3 * index.vertex_index + 1],
+        attrib.vertices[3 * index.vertex_index + 2]
+    };
+
+    // Normal
+    if (index.normal_index >= 0) {
+        v.normal = {
+            attrib.normals[3 * index.normal_index],
+            attrib.normals[3 * index.normal_index + 1],
+            attrib.normals[3 * index.normal_index + 2]
+        };
+    }
+
+    // Texcoord
+    if (index.texcoord_index >= 0) {
+        v.texcoord = {
+            attrib.texcoords[2 * index.texcoord_index],
+            1 - attrib.texcoords[2 * index.texcoord_index + 1]
+        };
+    }
+
+    return v;
+}
+
+void Model::loadObj(const std::string &objFilename, const std::string &mtlBasedir) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string err, warn;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objFilename.c_str(), mtlBasedir.c_str())) {
+    ObjParser parser;
+    if (!parser.load(&attrib, &shapes, &materials, &warn, &err, objFilename, mtlBasedir)) {
         throw std::runtime_error("Failed to load .obj file: " + objFilename + "\n");
     }
 
@@ -41,44 +579,72 @@ void Model::load(const std::string &objFilename, const std::string &mtlBasedir)
     std::cout << materials.size() << std::endl;
     std::cout << shapes.size() << std::endl;
 
-    std::unordered_map<Vertex, size_t> uniqueVertices;
-    uint32_t idx = 0;
+    for (const auto& material : materials) {
+        materials_.push_back({material.name, materialPath(mtlBasedir, material.diffuse_texname),
+                              glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2])});
+        materialTexnames_.push_back(material.diffuse_texname);
+    }
+
+    size_t indexCount = 0;
+    for (const auto& shape : shapes) {
+        indexCount += shape.mesh.indices.size();
+    }
+    indices_.reserve(indexCount);
+
+    // Every corner is looked up once. Welding by index only builds a vertex
+    // the first time its (position, normal, texcoord) triple is seen.
+    WeldTable weld(indexCount);
+    std::vector<tinyobj::index_t> weldKeys;
+    auto addCorner = [&](const tinyobj::index_t &index) {
+        uint32_t next = (uint32_t)vertices_.size();
+
+        if (options_.weld == WeldMode::eIndex) {
+            uint32_t hash = hashIndexTriple(index.vertex_index, index.normal_index, index.texcoord_index);
+            auto [id, inserted] = weld.findOrInsert(hash, next, [&](uint32_t k) {
+                const auto& key = weldKeys[k];
+                return key.vertex_index == index.vertex_index &&
+                       key.normal_index == index.normal_index &&
+                       key.texcoord_index == index.texcoord_index;
+            });
+            if (inserted) {
+                vertices_.push_back(makeVertex(attrib, index));
+                weldKeys.push_back(index);
+            }
+            indices_.push_back(id);
+        } else {
+            Vertex v = makeVertex(attrib, index);
+            auto [id, inserted] = weld.findOrInsert(hashVertex(v), next, [&](uint32_t k) {
+                return vertices_[k] == v;
+            });
+            if (inserted) {
+                vertices_.push_back(v);
+            }
+            indices_.push_back(id);
+        }
+    };
+
+    // A shape becomes one submesh per material it uses, in order of first use
+    std::vector<int> shapeMaterials;
     for (uint32_t i = 0; i < shapes.size(); ++ i) {
         auto &mesh = shapes[i].mesh;
-        uint32_t num_index = mesh.indices.size();
-        uint32_t num_face = mesh.num_face_vertices.size();
-
-        submodel_.push_back({indices_.size(), indices_.size() + num_index - 1});
-        
-        for (uint32_t j = 0; j < num_index; ++ j) {
-            auto &index = mesh.indices[j];
-            Vertex v = {};
-
-            // Position
-            v.pos = {
-                attrib.vertices[3 * index.vertex_index],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            // Normal
-            v.normal = {
-                attrib.normals[3 * index.normal_index],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            };
-
-            // Texcoord
-            v.texcoord = {
-                attrib.texcoords[2 * index.texcoord_index],
-                1 - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            if (uniqueVertices.count(v) == 0) {
-                uniqueVertices[v] = (uint32_t)vertices_.size();
-                vertices_.push_back(v);
+        uint32_t num_face = mesh.indices.size() / 3;
+
+        shapeMaterials.clear();
+        for (int material : mesh.material_ids) {
+            if (std::find(shapeMaterials.begin(), shapeMaterials.end(), material) == shapeMaterials.end()) {
+                shapeMaterials.push_back(material);
+            }
+        }
+
+        for (int material : shapeMaterials) {
+            uint64_t begin = indices_.size();
+            for (uint32_t f = 0; f < num_face; ++ f) {
+                if (mesh.material_ids[f] != material) continue;
+                addCorner(mesh.indices[3 * f]);
+                addCorner(mesh.indices[3 * f + 1]);
+                addCorner(mesh.indices[3 * f + 2]);
             }
-            indices_.push_back(uniqueVertices[v]);
+            submodel_.push_back({begin, indices_.size() - 1, material, 0});
         }
     }
 
@@ -1,29 +1,137 @@
 #pragma once
 
+#include <cstring>
+#include <memory>
+#include <span>
 #include "tiny_obj_loader.h"
 #include "vertex.h"
+#include "mesh_cache.h"
+#include "meshlet.h"
+#include "mesh_simplifier.h"
+#include "texture_atlas.h"
 
 namespace huahualib {
 
+enum class WeldMode : uint32_t {
+    eIndex,     // Merge corners that share the same OBJ (v, vn, vt) indices
+    eValue,     // Merge corners whose attribute values are identical
+};
+
+struct ModelLoadOptions {
+    WeldMode weld = WeldMode::eIndex;
+    bool optimizeVertexCache = true;    // Reorder triangles for post-transform cache hits
+    bool optimizeOverdraw = false;      // Then reorder triangle clusters to reduce overdraw
+    bool optimizeVertexFetch = true;    // Then move vertices into first-use order
+    VertexFormat vertexFormat = VertexFormat::eFull;    // eCompact also builds compactVertices()
+    bool buildMeshlets = false;         // Partition submeshes into meshlets(), reorders indices to match
+    uint32_t lodCount = 0;              // Simplified levels appended after level 0, at most 15
+    float lodReduction = 0.5f;          // Triangle ratio between consecutive levels
+    float lodTargetError = 0.05f;       // Max simplification error, relative to the model's radius
+    // Diffuse textures up to atlasMaxSize texels on each side are packed into atlas pages and their
+    // texcoords remapped. Applied after the mesh cache, so it is not part of key(). 0 disables it.
+    uint32_t atlasMaxSize = 0;
+    uint32_t atlasPageSize = 2048;
+
+    // Packs every option that changes the loaded data, stored in the mesh cache
+    uint32_t key() const {
+        return (uint32_t)weld |
+               (uint32_t)optimizeVertexCache << 8 |
+               (uint32_t)optimizeOverdraw << 9 |
+               (uint32_t)optimizeVertexFetch << 10 |
+               (uint32_t)vertexFormat << 11 |
+               (uint32_t)buildMeshlets << 12 |
+               std::min(lodCount, 15u) << 13 |
+               (lodCount ? lodParamsHash() << 17 : 0u);
+    }
+
+private:
+    uint32_t lodParamsHash() const {
+        uint32_t bits[2];
+        memcpy(&bits[0], &lodReduction, sizeof(float));
+        memcpy(&bits[1], &lodTargetError, sizeof(float));
+        return (bits[0] * 0x9e3779b1u ^ bits[1] * 0x85ebca77u) >> 17;
+    }
+};
+
+struct ModelMaterial final {
+    std::string name;
+    std::string diffuseTexture;     // full path, empty when the material has no map_Kd
+    glm::vec3 diffuse = glm::vec3(1.f);
+    int32_t atlasPage = -1;         // page of atlas() holding diffuseTexture, the texcoords already point into it
+};
+
 class Model {
 public:
-    Model(const std::string &objFilename, const std::string &mtlBasedir);
+    Model(const std::string &objFilename, const std::string &mtlBasedir, const ModelLoadOptions &options = {});
     ~Model();
 
-    std::vector<Vertex>& vertices();
-    std::vector<uint32_t>& indices();
+    // Views stay valid for the lifetime of the model. When the model comes from
+    // a binary cache they point straight into the mapped file.
+    std::span<const Vertex> vertices() const;
+    std::span<const uint32_t> indices() const;
+
+    // Shapes are split so every submesh uses one material. Ranges index
+    // indices() with inclusive ends, material is -1 when a face has none.
+    std::span<const MeshCacheSubmesh> submeshes() const;
+    std::span<const ModelMaterial> materials() const;
+
+    // Only filled when loaded with VertexFormat::eCompact. The quantization
+    // maps compact positions back to object space.
+    std::span<const CompactVertex> compactVertices() const;
+    const VertexQuantization& quantization() const;
+
+    // Only filled when loaded with buildMeshlets
+    const MeshletData& meshlets() const;
+
+    // Level 0 is the full mesh, simplified levels follow when loaded with lodCount.
+    // All levels index vertices(); the submesh ranges of a level use inclusive ends.
+    std::span<const MeshLod> lods() const;
+    std::span<const MeshCacheSubmesh> lodSubmeshes(uint32_t level) const;
+
+    // Bounding sphere of all vertices, in object space
+    const BoundingSphere& bounds() const;
+    // Per submesh, in object space, indexed like submeshes()
+    std::span<const BoundingBox> submeshBoxes() const;
+    std::span<const BoundingSphere> submeshSpheres() const;
+
+    // Only filled when loaded with atlasMaxSize. Textures that repeat, or whose vertices are
+    // shared with another texture, keep their own image.
+    const TextureAtlas& atlas() const;
 
 private:
-    struct VerticesRange {
-        size_t begin_ = 0, end_ = 0;
-    };
+    using VerticesRange = MeshCacheSubmesh;
 
     std::vector<Vertex> vertices_;
     std::vector<uint32_t> indices_;
     std::vector<VerticesRange> submodel_;
+    std::vector<ModelMaterial> materials_;
+    std::vector<std::string> materialTexnames_;    // map_Kd as written in the .mtl, for the mesh cache
+    std::vector<CompactVertex> compactVertices_;
+    VertexQuantization quantization_;
+    MeshletData meshlets_;
+    std::vector<MeshLod> lods_;
+    std::vector<VerticesRange> lodSubmodel_;    // [level * submeshCount + submesh]
+    BoundingSphere bounds_;
+    std::vector<BoundingBox> submeshBoxes_;
+    std::vector<BoundingSphere> submeshSpheres_;
+    TextureAtlas atlas_;
+    ModelLoadOptions options_;
+
+    std::unique_ptr<MeshCache> cache_;
+    std::span<const Vertex> vertexView_;
+    std::span<const uint32_t> indexView_;
+    std::span<const CompactVertex> compactView_;
 
     void load(const std::string &objFilename, const std::string &mtlBasedir);
+    static Vertex makeVertex(const tinyobj::attrib_t &attrib, const tinyobj::index_t &index);
+    void loadObj(const std::string &objFilename, const std::string &mtlBasedir);
+    void optimize();
+    void buildLods();
+    void computeBounds();
+    void buildAtlas();
+    bool loadCache(const std::string &cacheFilename, const std::string &mtlBasedir, uint64_t sourceHash, uint64_t sourceSize);
+    void saveCache(const std::string &cacheFilename, uint64_t sourceHash, uint64_t sourceSize) const;
 
 };
 
-}
\ No newline at end of file
+}
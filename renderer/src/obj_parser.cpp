@@ -0,0 +1,431 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace huahualib {
+
+namespace {
+
+constexpr size_t kMinChunkSize = 1 << 20;
+
+// Face corner as written in the file. Relative (negative) indices are stored
+// as chunk-local positions and marked, they become global in the resolve pass.
+struct RawIndex {
+    int v, vt, vn;
+    uint8_t relative;   // bit 0: v, bit 1: vt, bit 2: vn
+};
+
+enum class CommandType {
+    eFaces,
+    eObject,
+    eGroup,
+    eUseMtl,
+    eMtlLib,
+};
+
+struct Command {
+    CommandType type;
+    uint32_t faceBegin = 0, faceEnd = 0;
+    std::string name;
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++ p;
+    return p;
+}
+
+const char* skipToken(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) ++ p;
+    return p;
+}
+
+const char* parseFloat(const char* p, const char* end, float &out) {
+    p = skipSpace(p, end);
+    if (p < end && *p == '+') ++ p;
+    // Parsed as double and narrowed like tinyobj. from_chars rounds correctly, tinyobj's own
+    // tryParseDouble does not, so values may differ from tinyobj's in the last bit.
+    double value = 0.0;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        out = 0.f;
+        return skipToken(p, end);
+    }
+    out = (float)value;
+    return result.ptr;
+}
+
+const char* parseInt(const char* p, const char* end, int &out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++ p;
+    }
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        ++ p;
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+const char* skipIndexPart(const char* p, const char* end) {
+    while (p < end && *p != '/' && !isSpace(*p)) ++ p;
+    return p;
+}
+
+// Splits "v", "v/vt", "v//vn" and "v/vt/vn"; missing parts are 0
+const char* parseTriple(const char* p, const char* end, int &v, int &vt, int &vn) {
+    v = vt = vn = 0;
+    p = skipIndexPart(parseInt(p, end, v), end);
+    if (p >= end || *p != '/') return p;
+    ++ p;
+
+    if (p < end && *p == '/') {
+        ++ p;
+        return skipIndexPart(parseInt(p, end, vn), end);
+    }
+
+    p = skipIndexPart(parseInt(p, end, vt), end);
+    if (p >= end || *p != '/') return p;
+    ++ p;
+    return skipIndexPart(parseInt(p, end, vn), end);
+}
+
+// Converts one OBJ index to 0-based, see tinyobj fixIndex()
+bool fixIndex(int idx, size_t localCount, bool allowZero, int &out, bool &relative) {
+    relative = false;
+    if (idx > 0) {
+        out = idx - 1;
+        return true;
+    }
+    if (idx == 0) {
+        out = -1;
+        return allowZero;
+    }
+    out = (int)localCount + idx;
+    relative = true;
+    return true;
+}
+
+}
+
+struct ObjParser::Chunk {
+    const char* begin;
+    const char* end;
+
+    std::vector<float> v, vn, vt;
+    std::vector<RawIndex> corners;
+    std::vector<uint32_t> faceSizes;
+    std::vector<Command> commands;
+
+    // Filled by the resolve pass
+    std::vector<tinyobj::index_t> indices;
+    size_t vOffset = 0, vnOffset = 0, vtOffset = 0;
+
+    std::string err;
+};
+
+ObjParser::ObjParser(ThreadPool& pool): pool_(pool) {
+
+}
+
+void ObjParser::parseChunk(Chunk &chunk) {
+    const char* p = chunk.begin;
+
+    auto facesCommand = [&]() -> Command& {
+        if (chunk.commands.empty() || chunk.commands.back().type != CommandType::eFaces) {
+            Command cmd;
+            cmd.type = CommandType::eFaces;
+            cmd.faceBegin = cmd.faceEnd = (uint32_t)chunk.faceSizes.size();
+            chunk.commands.push_back(std::move(cmd));
+        }
+        return chunk.commands.back();
+    };
+
+    while (p < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+        if (!lineEnd) lineEnd = chunk.end;
+        const char* next = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+        if (lineEnd > p && lineEnd[-1] == '\r') -- lineEnd;
+
+        const char* token = skipSpace(p, lineEnd);
+        p = next;
+        if (token >= lineEnd || *token == '#') continue;
+
+        const char* tokenEnd = skipToken(token, lineEnd);
+        size_t tokenLen = tokenEnd - token;
+        const char* args = skipSpace(tokenEnd, lineEnd);
+
+        if (tokenLen == 1 && token[0] == 'v') {
+            float x, y, z;
+            args = parseFloat(args, lineEnd, x);
+            args = parseFloat(args, lineEnd, y);
+            parseFloat(args, lineEnd, z);
+            chunk.v.insert(chunk.v.end(), {x, y, z});
+        } else if (tokenLen == 2 && token[0] == 'v' && token[1] == 'n') {
+            float x, y, z;
+            args = parseFloat(args, lineEnd, x);
+            args = parseFloat(args, lineEnd, y);
+            parseFloat(args, lineEnd, z);
+            chunk.vn.insert(chunk.vn.end(), {x, y, z});
+        } else if (tokenLen == 2 && token[0] == 'v' && token[1] == 't') {
+            float x, y;
+            args = parseFloat(args, lineEnd, x);
+            parseFloat(args, lineEnd, y);
+            chunk.vt.insert(chunk.vt.end(), {x, y});
+        } else if (tokenLen == 1 && token[0] == 'f') {
+            uint32_t count = 0;
+            while (args < lineEnd) {
+                int v, vt, vn;
+                RawIndex index;
+                bool relV, relVt, relVn;
+                args = parseTriple(args, lineEnd, v, vt, vn);
+                if (!fixIndex(v, chunk.v.size() / 3, false, index.v, relV) ||
+                    !fixIndex(vt, chunk.vt.size() / 2, true, index.vt, relVt) ||
+                    !fixIndex(vn, chunk.vn.size() / 3, true, index.vn, relVn)) {
+                    chunk.err += "Failed parse `f' line: " + std::string(token, lineEnd) + "\n";
+                    return;
+                }
+                index.relative = (relV ? 1 : 0) | (relVt ? 2 : 0) | (relVn ? 4 : 0);
+                chunk.corners.push_back(index);
+                ++ count;
+                args = skipSpace(args, lineEnd);
+            }
+            auto& cmd = facesCommand();
+            chunk.faceSizes.push_back(count);
+            cmd.faceEnd = (uint32_t)chunk.faceSizes.size();
+        } else if (tokenLen == 6 && strncmp(token, "usemtl", 6) == 0) {
+            chunk.commands.push_back({CommandType::eUseMtl, 0, 0, std::string(args, skipToken(args, lineEnd))});
+        } else if (tokenLen == 6 && strncmp(token, "mtllib", 6) == 0) {
+            chunk.commands.push_back({CommandType::eMtlLib, 0, 0, std::string(args, lineEnd)});
+        } else if (tokenLen == 1 && token[0] == 'o') {
+            chunk.commands.push_back({CommandType::eObject, 0, 0, std::string(args, lineEnd)});
+        } else if (tokenLen == 1 && token[0] == 'g') {
+            // Multiple group names are joined with a space, as tinyobj does
+            std::string name;
+            while (args < lineEnd) {
+                const char* nameEnd = skipToken(args, lineEnd);
+                if (!name.empty()) name += ' ';
+                name.append(args, nameEnd);
+                args = skipSpace(nameEnd, lineEnd);
+            }
+            chunk.commands.push_back({CommandType::eGroup, 0, 0, std::move(name)});
+        }
+    }
+}
+
+bool ObjParser::load(tinyobj::attrib_t *attrib,
+                     std::vector<tinyobj::shape_t> *shapes,
+                     std::vector<tinyobj::material_t> *materials,
+                     std::string *warn, std::string *err,
+                     const std::string &objFilename, const std::string &mtlBasedir) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+
+    MappedFile file(objFilename);
+    if (!file.valid()) {
+        if (err) *err += "Cannot open file [" + objFilename + "]\n";
+        return false;
+    }
+
+    // 1. Split into line-aligned chunks
+    const char* data = static_cast<const char*>(file.data());
+    const char* dataEnd = data + file.size();
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(pool_.size() * 4, file.size() / kMinChunkSize));
+
+    std::vector<Chunk> chunks(chunkCount);
+    const char* begin = data;
+    for (size_t i = 0; i < chunkCount; ++ i) {
+        const char* end = i + 1 == chunkCount ? dataEnd : data + file.size() * (i + 1) / chunkCount;
+        if (end < begin) end = begin;
+        if (end < dataEnd) {
+            auto newline = static_cast<const char*>(memchr(end, '\n', dataEnd - end));
+            end = newline ? newline + 1 : dataEnd;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+
+    // 2. Parse chunks in parallel
+    pool_.parallelFor(chunkCount, [&](size_t i) {
+        parseChunk(chunks[i]);
+    });
+
+    size_t vCount = 0, vnCount = 0, vtCount = 0;
+    for (auto& chunk : chunks) {
+        if (!chunk.err.empty()) {
+            if (err) *err += chunk.err;
+            return false;
+        }
+        chunk.vOffset = vCount;
+        chunk.vnOffset = vnCount;
+        chunk.vtOffset = vtCount;
+        vCount += chunk.v.size() / 3;
+        vnCount += chunk.vn.size() / 3;
+        vtCount += chunk.vt.size() / 2;
+    }
+
+    // 3. Copy attributes to their global offsets and resolve face indices
+    attrib->vertices.resize(vCount * 3);
+    attrib->normals.resize(vnCount * 3);
+    attrib->texcoords.resize(vtCount * 2);
+    std::atomic<bool> outOfRange = false;
+    pool_.parallelFor(chunkCount, [&](size_t i) {
+        auto& chunk = chunks[i];
+        std::copy(chunk.v.begin(), chunk.v.end(), attrib->vertices.begin() + chunk.vOffset * 3);
+        std::copy(chunk.vn.begin(), chunk.vn.end(), attrib->normals.begin() + chunk.vnOffset * 3);
+        std::copy(chunk.vt.begin(), chunk.vt.end(), attrib->texcoords.begin() + chunk.vtOffset * 2);
+
+        chunk.indices.resize(chunk.corners.size());
+        for (size_t j = 0; j < chunk.corners.size(); ++ j) {
+            const auto& raw = chunk.corners[j];
+            auto& index = chunk.indices[j];
+            index.vertex_index = raw.relative & 1 ? raw.v + (int)chunk.vOffset : raw.v;
+            index.texcoord_index = raw.relative & 2 ? raw.vt + (int)chunk.vtOffset : raw.vt;
+            index.normal_index = raw.relative & 4 ? raw.vn + (int)chunk.vnOffset : raw.vn;
+            if (index.vertex_index < 0 || index.vertex_index >= (int)vCount ||
+                index.texcoord_index >= (int)vtCount || index.normal_index >= (int)vnCount) {
+                outOfRange = true;
+            }
+        }
+    });
+    if (outOfRange) {
+        if (err) *err += "Face with invalid vertex index found in [" + objFilename + "]\n";
+        return false;
+    }
+
+    // 4. Replay commands in file order to build triangulated shapes
+    std::string baseDir = mtlBasedir;
+    if (!baseDir.empty() && baseDir.back() != '/' && baseDir.back() != '\\') baseDir += '/';
+    tinyobj::MaterialFileReader readMaterial(baseDir);
+    std::map<std::string, int> materialMap;
+    std::set<std::string> materialFilenames;
+
+    tinyobj::shape_t shape;
+    std::string name;
+    int material = -1;
+    const auto& positions = attrib->vertices;
+
+    auto pushTriangle = [&](const tinyobj::index_t &a, const tinyobj::index_t &b, const tinyobj::index_t &c) {
+        shape.mesh.indices.push_back(a);
+        shape.mesh.indices.push_back(b);
+        shape.mesh.indices.push_back(c);
+        shape.mesh.num_face_vertices.push_back(3);
+        shape.mesh.material_ids.push_back(material);
+        shape.mesh.smoothing_group_ids.push_back(0);
+    };
+
+    auto flushShape = [&]() {
+        if (!shape.mesh.indices.empty()) {
+            shapes->push_back(std::move(shape));
+        }
+        shape = tinyobj::shape_t();
+    };
+
+    for (auto& chunk : chunks) {
+        size_t corner = 0;
+        uint32_t face = 0;
+        for (auto& cmd : chunk.commands) {
+            switch (cmd.type) {
+            case CommandType::eFaces:
+                for (; face < cmd.faceBegin; ++ face) corner += chunk.faceSizes[face];
+                shape.name = name;
+                for (; face < cmd.faceEnd; ++ face) {
+                    uint32_t n = chunk.faceSizes[face];
+                    const tinyobj::index_t* idx = chunk.indices.data() + corner;
+                    corner += n;
+
+                    if (n < 3) {
+                        if (warn) *warn += "Degenerated face found\n.";
+                        continue;
+                    }
+
+                    if (n == 4) {
+                        // Split along the shorter diagonal, same rule as tinyobj
+                        auto sqrDist = [&](int a, int b) {
+                            float dx = positions[3 * b] - positions[3 * a];
+                            float dy = positions[3 * b + 1] - positions[3 * a + 1];
+                            float dz = positions[3 * b + 2] - positions[3 * a + 2];
+                            return dx * dx + dy * dy + dz * dz;
+                        };
+                        if (sqrDist(idx[0].vertex_index, idx[2].vertex_index) < sqrDist(idx[1].vertex_index, idx[3].vertex_index)) {
+                            pushTriangle(idx[0], idx[1], idx[2]);
+                            pushTriangle(idx[0], idx[2], idx[3]);
+                        } else {
+                            pushTriangle(idx[0], idx[1], idx[3]);
+                            pushTriangle(idx[1], idx[2], idx[3]);
+                        }
+                        continue;
+                    }
+
+                    for (uint32_t k = 1; k + 1 < n; ++ k) {
+                        pushTriangle(idx[0], idx[k], idx[k + 1]);
+                    }
+                }
+                break;
+
+            case CommandType::eUseMtl: {
+                auto it = materialMap.find(cmd.name);
+                if (it != materialMap.end()) {
+                    material = it->second;
+                } else {
+                    if (warn) *warn += "material [ '" + cmd.name + "' ] not found in .mtl\n";
+                    material = -1;
+                }
+                break;
+            }
+
+            case CommandType::eMtlLib: {
+                // Use the first library in the list that loads
+                const char* p = cmd.name.data();
+                const char* end = p + cmd.name.size();
+                bool found = false;
+                while (p < end && !found) {
+                    const char* nameEnd = skipToken(p, end);
+                    std::string filename(p, nameEnd);
+                    p = skipSpace(nameEnd, end);
+                    if (materialFilenames.count(filename)) {
+                        found = true;
+                        continue;
+                    }
+
+                    std::string warnMtl, errMtl;
+                    if (readMaterial(filename, materials, &materialMap, &warnMtl, &errMtl)) {
+                        materialFilenames.insert(filename);
+                        found = true;
+                    }
+                    if (warn) *warn += warnMtl;
+                    if (err) *err += errMtl;
+                }
+                if (!found && warn) *warn += "Failed to load material file(s). Use default material.\n";
+                break;
+            }
+
+            case CommandType::eObject:
+            case CommandType::eGroup:
+                flushShape();
+                name = cmd.name;
+                break;
+            }
+        }
+    }
+    flushShape();
+
+    return true;
+}
+
+}
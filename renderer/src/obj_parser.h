@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "tiny_obj_loader.h"
+#include "thread_pool.h"
+
+namespace huahualib {
+
+// Multi-threaded .obj loader producing the same triangulated attrib/shape/material
+// layout as tinyobj::LoadObj.
+//
+// The file is mapped and split into line-aligned chunks that are parsed on the
+// thread pool. A second parallel pass places every chunk's v/vn/vt records at
+// their global offsets and resolves relative (negative) face indices, and a
+// final sequential pass replays o/g/usemtl/mtllib in file order to build shapes.
+//
+// Differences from tinyobj: vertex colors, smoothing groups, lines and points
+// are not read, and polygons with more than four corners are fan triangulated.
+class ObjParser final {
+public:
+    ObjParser(ThreadPool& pool = ThreadPool::instance());
+
+    bool load(tinyobj::attrib_t *attrib,
+              std::vector<tinyobj::shape_t> *shapes,
+              std::vector<tinyobj::material_t> *materials,
+              std::string *warn, std::string *err,
+              const std::string &objFilename, const std::string &mtlBasedir);
+
+private:
+    struct Chunk;
+
+    ThreadPool& pool_;
+
+    void parseChunk(Chunk &chunk);
+};
+
+}
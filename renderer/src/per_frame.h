@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace huahualib {
+
+inline constexpr uint32_t kMaxFramesInFlight = 3;
+
+// One T per frame in flight, for anything double or triple buffered. N bounds the frame count,
+// the count in use is picked at runtime. Frame i's T must only be written while frame i is recorded,
+// that is after its fence has signaled, the others may still be read by the GPU.
+template<typename T, uint32_t N = kMaxFramesInFlight>
+class PerFrame final {
+public:
+    PerFrame() = default;
+    explicit PerFrame(uint32_t count) { resize(count); }
+
+    // Every frame's T is value initialized
+    void resize(uint32_t count) { assign(count, T{}); }
+    void assign(uint32_t count, const T& value) {
+        if (count > N) {
+            throw std::runtime_error("Failed to create per-frame resources, at most " + std::to_string(N) + " frames are supported!\n");
+        }
+        for (uint32_t i = 0; i < N; ++ i) {
+            items_[i] = i < count ? value : T{};
+        }
+        count_ = count;
+    }
+
+    T& operator[](uint32_t frame) { return items_[frame]; }
+    const T& operator[](uint32_t frame) const { return items_[frame]; }
+    uint32_t size() const { return count_; }
+
+    auto begin() { return items_.begin(); }
+    auto end() { return items_.begin() + count_; }
+    auto begin() const { return items_.begin(); }
+    auto end() const { return items_.begin() + count_; }
+
+private:
+    std::array<T, N> items_{};
+    uint32_t count_ = 0;
+};
+
+}
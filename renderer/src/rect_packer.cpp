@@ -0,0 +1,91 @@
+#include "rect_packer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace huahualib {
+
+RectPacker::RectPacker(uint32_t width, uint32_t height): width_(width), height_(height) {
+    reset();
+}
+
+void RectPacker::reset() {
+    usedArea_ = 0;
+    skyline_.assign(1, {0, 0, width_});
+}
+
+uint32_t RectPacker::width() const {
+    return width_;
+}
+
+uint32_t RectPacker::height() const {
+    return height_;
+}
+
+float RectPacker::occupancy() const {
+    return width_ && height_ ? (float)((double)usedArea_ / ((double)width_ * height_)) : 0.f;
+}
+
+uint32_t RectPacker::fitAt(size_t index, uint32_t w, uint32_t h) const {
+    if (skyline_[index].x + w > width_) return std::numeric_limits<uint32_t>::max();
+
+    // The rectangle rests on the highest segment under it
+    uint32_t y = 0;
+    uint32_t covered = 0;
+    for (size_t i = index; covered < w; ++ i) {
+        y = std::max(y, skyline_[i].y);
+        covered += skyline_[i].width;
+    }
+    return y + h <= height_ ? y : std::numeric_limits<uint32_t>::max();
+}
+
+bool RectPacker::pack(uint32_t w, uint32_t h, uint32_t &x, uint32_t &y) {
+    if (w == 0 || h == 0 || w > width_ || h > height_) return false;
+
+    size_t best = skyline_.size();
+    uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+    uint32_t bestWidth = std::numeric_limits<uint32_t>::max();
+    for (size_t i = 0; i < skyline_.size(); ++ i) {
+        uint32_t fitY = fitAt(i, w, h);
+        if (fitY == std::numeric_limits<uint32_t>::max()) continue;
+        uint32_t top = fitY + h;
+        if (top < bestTop || (top == bestTop && skyline_[i].width < bestWidth)) {
+            best = i;
+            bestTop = top;
+            bestWidth = skyline_[i].width;
+        }
+    }
+    if (best == skyline_.size()) return false;
+
+    x = skyline_[best].x;
+    y = bestTop - h;
+
+    // The new segment replaces everything it covers, a partly covered one is shortened
+    Segment placed = {x, bestTop, w};
+    size_t end = best;
+    while (end < skyline_.size() && skyline_[end].x + skyline_[end].width <= x + w) {
+        ++ end;
+    }
+    if (end < skyline_.size() && skyline_[end].x < x + w) {
+        uint32_t cut = x + w - skyline_[end].x;
+        skyline_[end].x += cut;
+        skyline_[end].width -= cut;
+    }
+    skyline_.erase(skyline_.begin() + best, skyline_.begin() + end);
+    skyline_.insert(skyline_.begin() + best, placed);
+
+    // Neighbours at the same height merge
+    for (size_t i = 0; i + 1 < skyline_.size(); ) {
+        if (skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            ++ i;
+        }
+    }
+
+    usedArea_ += (uint64_t)w * h;
+    return true;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace huahualib {
+
+// Skyline bottom-left packer. Each rectangle goes where its top edge ends lowest,
+// ties go to the narrower gap, which keeps the leftover space in few wide strips.
+class RectPacker final {
+public:
+    RectPacker(uint32_t width, uint32_t height);
+
+    // False when w x h does not fit anywhere, the packer is unchanged then
+    bool pack(uint32_t w, uint32_t h, uint32_t &x, uint32_t &y);
+    void reset();
+
+    uint32_t width() const;
+    uint32_t height() const;
+    // Fraction of the area covered by packed rectangles
+    float occupancy() const;
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;         // height of the skyline over [x, x + width)
+        uint32_t width;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+    uint64_t usedArea_ = 0;
+    std::vector<Segment> skyline_;
+
+    // Top of a w wide rectangle whose left edge sits on segment index, UINT32_MAX when it does not fit
+    uint32_t fitAt(size_t index, uint32_t w, uint32_t h) const;
+};
+
+}
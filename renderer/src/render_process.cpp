@@ -11,6 +11,7 @@ RenderProcess::RenderProcess() {
     layout = createLayout();
     renderPass = createRenderPass_();
     pipeline = nullptr;
+    compactPipeline = nullptr;
 }
 
 RenderProcess::~RenderProcess() {
@@ -18,25 +19,35 @@ RenderProcess::~RenderProcess() {
     device.destroyRenderPass(renderPass);
     device.destroyPipelineLayout(layout);
     device.destroyPipeline(pipeline);
+    device.destroyPipeline(compactPipeline);
 }
 
 void RenderProcess::createGraphicsPipeline(const Shader& shader) {
     pipeline = createPipeline(shader, vk::PrimitiveTopology::eTriangleList);
 }
 
+void RenderProcess::createCompactGraphicsPipeline(const Shader& shader) {
+    compactPipeline = createPipeline(shader, vk::PrimitiveTopology::eTriangleList, VertexFormat::eCompact);
+}
+
+vk::Pipeline RenderProcess::getPipeline(VertexFormat format) const {
+    return format == VertexFormat::eCompact ? compactPipeline : pipeline;
+}
+
 void RenderProcess::createRenderPass() {
     renderPass = createRenderPass_();
 }
 
-vk::Pipeline RenderProcess::createPipeline(const Shader& shader, vk::PrimitiveTopology primitiveTopology) {
+vk::Pipeline RenderProcess::createPipeline(const Shader& shader, vk::PrimitiveTopology primitiveTopology, VertexFormat vertexFormat) {
     auto& ctx = Context::getInstance();
 
     vk::GraphicsPipelineCreateInfo pipelineInfo;
 
     // 1. Vertex Input
     vk::PipelineVertexInputStateCreateInfo inputStateInfo;
-    auto attrib = Vertex::getAttribute();
-    auto binding = Vertex::getBinding();
+    bool compact = vertexFormat == VertexFormat::eCompact;
+    auto attrib = compact ? CompactVertex::getAttribute() : Vertex::getAttribute();
+    auto binding = compact ? CompactVertex::getBinding() : Vertex::getBinding();
     inputStateInfo
         .setVertexBindingDescriptions(binding)
         .setVertexAttributeDescriptions(attrib);
@@ -2,12 +2,14 @@
 
 #include "vulkan/vulkan.hpp"
 #include "shader.h"
+#include "vertex.h"
 
 namespace huahualib {
 
 class RenderProcess final {
 public:
     vk::Pipeline pipeline;
+    vk::Pipeline compactPipeline;   // Same state, CompactVertex input
     vk::PipelineLayout layout;
     vk::RenderPass renderPass;
 
@@ -15,10 +17,12 @@ public:
     ~RenderProcess();
 
     void createGraphicsPipeline(const Shader& shader);
+    void createCompactGraphicsPipeline(const Shader& shader);
+    vk::Pipeline getPipeline(VertexFormat format) const;
     void createRenderPass();
 
 private:
-    vk::Pipeline createPipeline(const Shader& shader, vk::PrimitiveTopology primitiveTopology);
+    vk::Pipeline createPipeline(const Shader& shader, vk::PrimitiveTopology primitiveTopology, VertexFormat vertexFormat = VertexFormat::eFull);
     vk::PipelineLayout createLayout();
     vk::RenderPass createRenderPass_();
 };
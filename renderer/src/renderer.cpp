@@ -4,6 +4,10 @@
 #include "vertex.h"
 #include "uniform.h"
 
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm/glm.hpp"
@@ -28,6 +32,10 @@ Renderer::Renderer(int maxFlightCount): maxFlightCount_(maxFlightCount), curfram
     createTexture();
     createSampler();
     updateSets();
+
+    TextureStreamOptions streamOptions;
+    streamOptions.framesInFlight = maxFlightCount_;
+    streamer_ = std::make_unique<TextureStreamer>(streamOptions);
 }
 
 Renderer::~Renderer() {
@@ -46,10 +54,11 @@ Renderer::~Renderer() {
 
     vertexBuffer_.reset();
     indexBuffer_.reset();
+    streamer_.reset();
+    atlasTextures_.clear();
+    Context::getInstance().textureManagerPtr->release(textureHandle_);
 
-    for (auto& buffer : uniformBuffers_) {
-        buffer.reset();
-    }
+    frameUniforms_.reset();
 
     device.destroySampler(sampler);
 
@@ -62,6 +71,8 @@ void Renderer::beginRender() {
         std::cout << "Wair for fence failed!" << std::endl;
     }
     device.resetFences(fences_[curframe_]);
+    frameUniforms_->beginFrame(curframe_);
+    Context::getInstance().memoryAllocatorPtr->updateBudget();
 
     auto& renderProcessPtr = Context::getInstance().renderProcessPtr;
     auto& swapchainPtr = Context::getInstance().swapchainPtr;
@@ -91,11 +102,26 @@ void Renderer::endRender() {
     auto& cmdBuffer = cmdBuffers_[curframe_];
     cmdBuffer.end();
 
+    std::vector<vk::Semaphore> waitSemaphores = {imageAvaliables_[curframe_]};
     std::vector<vk::PipelineStageFlags> stageFlags = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    std::vector<uint64_t> waitValues = {0};     // ignored for binary semaphores
+
+    // Uploads the CPU did not wait for are waited on here, on the GPU, by the first frame that may use them
+    auto& uploads = *Context::getInstance().uploadQueuePtr;
+    if (!uploads.reached(uploads.lastSubmitted())) {
+        waitSemaphores.push_back(uploads.semaphore());
+        stageFlags.push_back(vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader |
+                             vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eFragmentShader);
+        waitValues.push_back(uploads.lastSubmitted());
+    }
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setWaitSemaphoreValues(waitValues);
     vk::SubmitInfo submitInfo;
     submitInfo
+        .setPNext(&timelineInfo)
         .setCommandBuffers(cmdBuffer)
-        .setWaitSemaphores(imageAvaliables_[curframe_])
+        .setWaitSemaphores(waitSemaphores)
         .setSignalSemaphores(imageDrawFinsihs_[curframe_])
         .setWaitDstStageMask(stageFlags);
     Context::getInstance().graphicsQueue.submit(submitInfo, fences_[curframe_]);
@@ -118,6 +144,9 @@ void Renderer::present() {
 
 void Renderer::render() {
     bufferUniformData();
+    Context::getInstance().textureManagerPtr->update();
+    streamer_->update();
+    refreshMaterialSets();
 
     auto& renderProcessPtr = Context::getInstance().renderProcessPtr;
     auto& swapchainPtr = Context::getInstance().swapchainPtr;
@@ -135,20 +164,59 @@ void Renderer::render() {
         .setFramebuffer(swapchainPtr->frameBuffers[curImageIndex_])
         .setClearValues(clearValues);
 
-    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, renderProcessPtr->pipeline);
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, renderProcessPtr->getPipeline(vertexFormat_));
     vk::DeviceSize offset = 0;
-    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Context::getInstance().renderProcessPtr->layout, 0, sets_[curframe_], {});
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, Context::getInstance().renderProcessPtr->layout, 0, sets_[curframe_], mvpOffset_);
     cmdBuffer.bindVertexBuffers(0, vertexBuffer_->buffer, offset);
-    cmdBuffer.bindIndexBuffer(indexBuffer_->buffer, 0, vk::IndexType::eUint32);
+    cmdBuffer.bindIndexBuffer(indexBuffer_->buffer, 0, indexType_);
     cmdBuffer.pushConstants(renderProcessPtr->layout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(glm::vec3), &color);
     cmdBuffer.beginRenderPass(renderPassBeginInfo, {}); {
-        cmdBuffer.drawIndexed(num_index, 1, 0, 0, 0);
+        uint32_t level = 0;
+        if (!lods_.empty()) {
+            float distance = glm::length(cullCameraPos_ - lodBounds_.center) - lodBounds_.radius;
+            level = selectLod(lods_, distance, lodProjectionScale_, lodMaxPixelError_);
+        }
+
+        if (!draws_.empty()) {
+            submeshVisible_.resize(submeshCuller_.size());
+            submeshCuller_.cull(cullFrustum_, submeshVisible_, ThreadPool::instance());
+
+            // Draws are sorted by texture, so each texture set is bound once
+            uint32_t boundSet = std::numeric_limits<uint32_t>::max();
+            for (const auto& draw : draws_[std::min<size_t>(level, draws_.size() - 1)]) {
+                if (draw.submesh < submeshVisible_.size() && !submeshVisible_[draw.submesh]) continue;
+                if (draw.textureSet != boundSet) {
+                    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, renderProcessPtr->layout, 1, materialSets_[curframe_][draw.textureSet], {});
+                    boundSet = draw.textureSet;
+                }
+                if (draw.textureSet > 0 && draw.textureSet <= materialHandles_.size()) {
+                    // Streams the texture in for the submesh's projected size
+                    const auto& sphere = submeshSpheres_[draw.submesh];
+                    float distance = std::max(glm::length(cullCameraPos_ - sphere.center), sphere.radius);
+                    streamer_->markUsed(materialHandles_[draw.textureSet - 1], 2.f * sphere.radius * lodProjectionScale_ / distance);
+                }
+                if (draw.meshletCount > 0) {
+                    drawMeshlets(cmdBuffer, draw.firstMeshlet, draw.meshletCount, draw.vertexOffset);
+                } else {
+                    cmdBuffer.drawIndexed(draw.indexCount, 1, draw.indexOffset, draw.vertexOffset, 0);
+                }
+            }
+        } else if (level > 0) {
+            // Meshlets only cover level 0
+            cmdBuffer.drawIndexed(lods_[level].indexCount, 1, lods_[level].indexOffset, 0, 0);
+        } else if (!meshlets_.empty()) {
+            drawMeshlets(cmdBuffer, 0, (uint32_t)meshlets_.size(), 0);
+        } else {
+            cmdBuffer.drawIndexed(lods_.empty() ? num_index : lods_[0].indexCount, 1, 0, 0, 0);
+        }
     } cmdBuffer.endRenderPass();
 
 }
 
 void Renderer::createCommandBuffers() {
-    cmdBuffers_ = Context::getInstance().cmdManagerPtr->createCommandBuffers(maxFlightCount_);
+    cmdBuffers_.resize(maxFlightCount_);
+    auto cmdBuffers = Context::getInstance().cmdManagerPtr->createCommandBuffers(maxFlightCount_);
+    std::copy(cmdBuffers.begin(), cmdBuffers.end(), cmdBuffers_.begin());
 }
 
 void Renderer::createSemaphore() {
@@ -171,9 +239,20 @@ void Renderer::createFance() {
     }
 }
 
-void Renderer::bindVertices(const std::vector<Vertex>& vertices) {
-    createVertexBuffer(sizeof(vertices[0]) * vertices.size());
-    bufferVertexData(vertices);
+void Renderer::bindVertices(std::span<const Vertex> vertices) {
+    vertexFormat_ = VertexFormat::eFull;
+    positionTransform_ = glm::mat4(1.f);
+    texcoordTransform_ = glm::vec4(1.f, 1.f, 0.f, 0.f);
+    createVertexBuffer(vertices.size_bytes());
+    bufferVertexData(std::as_bytes(vertices));
+}
+
+void Renderer::bindVertices(std::span<const CompactVertex> vertices, const VertexQuantization &quantization) {
+    vertexFormat_ = VertexFormat::eCompact;
+    positionTransform_ = quantization.matrix();
+    texcoordTransform_ = quantization.texcoordTransform();
+    createVertexBuffer(vertices.size_bytes());
+    bufferVertexData(std::as_bytes(vertices));
 }
 
 void Renderer::createVertexBuffer(size_t size) {
@@ -182,20 +261,248 @@ void Renderer::createVertexBuffer(size_t size) {
         vk::MemoryPropertyFlagBits::eDeviceLocal));
 }
 
-void Renderer::bufferVertexData(const std::vector<Vertex>& vertices) {
-    vk::DeviceSize size = sizeof(vertices[0]) * vertices.size();
-    auto stagingBufferPtr = std::make_unique<Buffer>(size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-    memcpy(stagingBufferPtr->map, vertices.data(), size);
-    copyBuffer(stagingBufferPtr->buffer, vertexBuffer_->buffer, 0, 0, stagingBufferPtr->size);
-    stagingBufferPtr.reset();
+void Renderer::bufferVertexData(std::span<const std::byte> vertices) {
+    UploadBatch batch;
+    batch.copyToBuffer(vertexBuffer_->buffer, vertices.data(), vertices.size());
+    batch.flush();
 }
 
-void Renderer::bindIndices(const std::vector<uint32_t>& indices) {
+void Renderer::bindIndices(std::span<const uint32_t> indices) {
     num_index = indices.size();
-    createIndexBuffer(sizeof(indices[0]) * indices.size());
-    bufferIndexData(indices);
+    uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+    if (maxIndex <= std::numeric_limits<uint16_t>::max()) {
+        std::vector<uint16_t> narrowed(indices.begin(), indices.end());
+        indexType_ = vk::IndexType::eUint16;
+        createIndexBuffer(sizeof(uint16_t) * narrowed.size());
+        bufferIndexData(std::as_bytes(std::span<const uint16_t>(narrowed)));
+    } else {
+        indexType_ = vk::IndexType::eUint32;
+        createIndexBuffer(indices.size_bytes());
+        bufferIndexData(std::as_bytes(indices));
+    }
+}
+
+void Renderer::bindMeshlets(std::span<const Meshlet> meshlets, std::span<const MeshletBounds> bounds) {
+    meshlets_.assign(meshlets.begin(), meshlets.end());
+    meshletBounds_.assign(bounds.begin(), bounds.end());
+}
+
+void Renderer::bindLods(std::span<const MeshLod> lods, const BoundingSphere &bounds, float maxPixelError) {
+    lods_.assign(lods.begin(), lods.end());
+    lodBounds_ = bounds;
+    lodMaxPixelError_ = maxPixelError;
+}
+
+void Renderer::bindModel(const Model &model) {
+    if (!model.compactVertices().empty()) {
+        bindVertices(model.compactVertices(), model.quantization());
+    } else {
+        bindVertices(model.vertices());
+    }
+    bindMeshlets(model.meshlets().meshlets, model.meshlets().bounds);
+    bindLods(model.lods(), model.bounds());
+    submeshCuller_.assign(model.submeshBoxes());
+    submeshSpheres_.assign(model.submeshSpheres().begin(), model.submeshSpheres().end());
+    bindMaterials(model);
+    bindDrawIndices(model.indices());
+}
+
+void Renderer::bindMaterials(const Model &model) {
+    auto& ctx = Context::getInstance();
+
+    // The previous model's sets and textures may still be used by frames in flight
+    ctx.device.waitIdle();
+    ctx.descriptorManagerPtr->freeMaterialSets();
+    for (auto handle : materialHandles_) {
+        streamer_->release(handle);
+    }
+    materialHandles_.clear();
+
+    // Materials sharing a texture share its set, set 0 and materials without one use the default texture.
+    // Set i > 0 shows the streamed materialHandles_[i - 1] once it is resident, the default until then.
+    // Atlas pages follow the streamed textures and are uploaded right away.
+    auto materials = model.materials();
+    std::vector<uint32_t> materialSet(materials.size(), 0);
+    std::unordered_map<std::string, uint32_t> pathSets;
+    for (size_t i = 0; i < materials.size(); ++ i) {
+        const auto& path = materials[i].diffuseTexture;
+        if (path.empty() || materials[i].atlasPage >= 0) continue;
+
+        auto it = pathSets.find(path);
+        if (it == pathSets.end()) {
+            materialHandles_.push_back(streamer_->request(path));
+            it = pathSets.emplace(path, (uint32_t)materialHandles_.size()).first;
+        }
+        materialSet[i] = it->second;
+    }
+
+    const auto& atlas = model.atlas();
+    uint32_t firstPageSet = (uint32_t)materialHandles_.size() + 1;
+    for (size_t i = 0; i < materials.size(); ++ i) {
+        if (materials[i].atlasPage >= 0) {
+            materialSet[i] = firstPageSet + (uint32_t)materials[i].atlasPage;
+        }
+    }
+
+    // Pages only get the levels whose texels stay inside the atlas border
+    atlasTextures_.clear();
+    {
+        UploadBatch batch;
+        std::vector<uint8_t> chain;
+        for (const auto& page : atlas.pages()) {
+            auto levels = buildMipChain(page.rgba.data(), page.width, page.height, true, chain);
+            levels.resize(std::min<size_t>(levels.size(), atlas.mipLevels()));
+            atlasTextures_.push_back(std::make_unique<Texture>(vk::Format::eR8G8B8A8Srgb, chain.data(), levels, batch));
+        }
+        batch.flush();
+    }
+
+    // One copy per frame in flight, a set is only rewritten after its frame's fence signalled.
+    // The pool is sized for this model, so any number of textures fits.
+    size_t setCount = firstPageSet + atlasTextures_.size();
+    auto layout = ctx.shaderManagerPtr->get(0)->getDescriptorSetLayouts()[1];
+    auto allSets = ctx.descriptorManagerPtr->allocateMaterialSets(layout, (uint32_t)(setCount * maxFlightCount_));
+    materialSets_.resize(maxFlightCount_);
+    materialGenerations_.assign(maxFlightCount_, std::vector<uint32_t>(setCount, 0));
+    for (int frame = 0; frame < maxFlightCount_; ++ frame) {
+        auto& sets = materialSets_[frame];
+        sets.assign(allSets.begin() + frame * setCount, allSets.begin() + (frame + 1) * setCount);
+        for (size_t i = 0; i < setCount; ++ i) {
+            writeMaterialSet(sets[i], i < firstPageSet ? texture : atlasTextures_[i - firstPageSet].get());
+        }
+    }
+
+    // One draw per submesh and level, meshlets of a submesh are contiguous since they were built per submesh
+    size_t levelCount = std::max<size_t>(1, lods_.size());
+    draws_.assign(levelCount, {});
+    for (size_t level = 0; level < levelCount; ++ level) {
+        auto submeshes = lods_.empty() ? model.submeshes() : model.lodSubmeshes((uint32_t)level);
+        for (size_t i = 0; i < submeshes.size(); ++ i) {
+            const auto& submesh = submeshes[i];
+            if (submesh.end + 1 <= submesh.begin) continue;    // empty submesh
+
+            DrawRecord draw = {};
+            draw.indexOffset = (uint32_t)submesh.begin;
+            draw.indexCount = (uint32_t)(submesh.end + 1 - submesh.begin);
+            draw.vertexOffset = 0;
+            draw.submesh = (uint32_t)i;
+            draw.textureSet = submesh.material >= 0 && submesh.material < (int32_t)materialSet.size() ? materialSet[submesh.material] : 0;
+
+            if (level == 0 && !meshlets_.empty()) {
+                uint32_t firstTriangle = draw.indexOffset / 3;
+                uint32_t endTriangle = (draw.indexOffset + draw.indexCount) / 3;
+                auto first = std::lower_bound(meshlets_.begin(), meshlets_.end(), firstTriangle, [](const Meshlet &m, uint32_t t) {
+                    return m.triangleOffset < t;
+                });
+                auto last = first;
+                while (last != meshlets_.end() && last->triangleOffset < endTriangle) ++ last;
+                draw.firstMeshlet = (uint32_t)(first - meshlets_.begin());
+                draw.meshletCount = (uint32_t)(last - first);
+            }
+            draws_[level].push_back(draw);
+        }
+
+        std::stable_sort(draws_[level].begin(), draws_[level].end(), [](const DrawRecord &a, const DrawRecord &b) {
+            return a.textureSet < b.textureSet;
+        });
+    }
+}
+
+void Renderer::bindDrawIndices(std::span<const uint32_t> indices) {
+    num_index = indices.size();
+    uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+    if (maxIndex <= std::numeric_limits<uint16_t>::max()) {
+        bindIndices(indices);
+        return;
+    }
+
+    // Too many vertices for 16 bits, but every draw may still span less than 65536 of them.
+    // Rebase each draw's indices to its lowest vertex and add that back with vertexOffset.
+    std::vector<uint16_t> rebased(indices.size());
+    std::vector<bool> covered(indices.size(), false);
+    std::vector<int32_t> offsets;
+    for (const auto& level : draws_) {
+        for (const auto& draw : level) {
+            auto range = indices.subspan(draw.indexOffset, draw.indexCount);
+            auto [lo, hi] = std::minmax_element(range.begin(), range.end());
+            if (*hi - *lo > std::numeric_limits<uint16_t>::max()) {
+                bindIndices(indices);
+                return;
+            }
+            for (uint32_t i = 0; i < draw.indexCount; ++ i) {
+                rebased[draw.indexOffset + i] = (uint16_t)(range[i] - *lo);
+                covered[draw.indexOffset + i] = true;
+            }
+            offsets.push_back((int32_t)*lo);
+        }
+    }
+    // Indices outside every draw would be drawn without a base, keep those at 32 bits
+    if (std::find(covered.begin(), covered.end(), false) != covered.end()) {
+        bindIndices(indices);
+        return;
+    }
+
+    size_t next = 0;
+    for (auto& level : draws_) {
+        for (auto& draw : level) {
+            draw.vertexOffset = offsets[next++];
+        }
+    }
+    indexType_ = vk::IndexType::eUint16;
+    createIndexBuffer(sizeof(uint16_t) * rebased.size());
+    bufferIndexData(std::as_bytes(std::span<const uint16_t>(rebased)));
+}
+
+void Renderer::writeMaterialSet(vk::DescriptorSet set, Texture* setTexture) {
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo
+        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setImageView(setTexture->view)
+        .setSampler(sampler);
+    vk::WriteDescriptorSet writer;
+    writer
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+        .setImageInfo(imageInfo)
+        .setDstSet(set)
+        .setDstBinding(0)
+        .setDstArrayElement(0)
+        .setDescriptorCount(1);
+    Context::getInstance().device.updateDescriptorSets(writer, {});
+}
+
+void Renderer::refreshMaterialSets() {
+    // Streamed textures are replaced whenever their residency changes
+    for (size_t i = 0; i < materialHandles_.size(); ++ i) {
+        auto handle = materialHandles_[i];
+        auto& generation = materialGenerations_[curframe_][i + 1];
+        if (generation == streamer_->generation(handle)) continue;
+
+        auto streamed = streamer_->texture(handle);
+        writeMaterialSet(materialSets_[curframe_][i + 1], streamed ? streamed : texture);
+        generation = streamer_->generation(handle);
+    }
+}
+
+void Renderer::drawMeshlets(vk::CommandBuffer cmdBuffer, uint32_t firstMeshlet, uint32_t meshletCount, int32_t vertexOffset) {
+    // Meshlets are contiguous in the index buffer, so neighbouring visible ones merge into one draw
+    uint32_t firstTriangle = 0, triangleCount = 0;
+    for (uint32_t i = firstMeshlet; i < firstMeshlet + meshletCount; ++ i) {
+        const auto& meshlet = meshlets_[i];
+        if (!meshletVisible(meshletBounds_[i], cullFrustum_, cullCameraPos_)) continue;
+
+        if (triangleCount > 0 && firstTriangle + triangleCount == meshlet.triangleOffset) {
+            triangleCount += meshlet.triangleCount;
+            continue;
+        }
+        if (triangleCount > 0) {
+            cmdBuffer.drawIndexed(3 * triangleCount, 1, 3 * firstTriangle, vertexOffset, 0);
+        }
+        firstTriangle = meshlet.triangleOffset;
+        triangleCount = meshlet.triangleCount;
+    }
+    if (triangleCount > 0) {
+        cmdBuffer.drawIndexed(3 * triangleCount, 1, 3 * firstTriangle, vertexOffset, 0);
+    }
 }
 
 void Renderer::createIndexBuffer(size_t size) {
@@ -204,23 +511,14 @@ void Renderer::createIndexBuffer(size_t size) {
         vk::MemoryPropertyFlagBits::eDeviceLocal));
 }
 
-void Renderer::bufferIndexData(const std::vector<uint32_t>& indices) {
-    vk::DeviceSize size = sizeof(indices[0]) * indices.size();
-    auto stagingBufferPtr = std::make_unique<Buffer>(size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-    memcpy(stagingBufferPtr->map, indices.data(), size);
-    copyBuffer(stagingBufferPtr->buffer, indexBuffer_->buffer, 0, 0, stagingBufferPtr->size);
-    stagingBufferPtr.reset();
+void Renderer::bufferIndexData(std::span<const std::byte> indices) {
+    UploadBatch batch;
+    batch.copyToBuffer(indexBuffer_->buffer, indices.data(), indices.size());
+    batch.flush();
 }
 
 void Renderer::createUniformBuffer() {
-    uniformBuffers_.resize(maxFlightCount_);
-    for (int i = 0; i < maxFlightCount_; ++ i) {
-        uniformBuffers_[i].reset(new Buffer(sizeof(MVP), 
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-    }
+    frameUniforms_ = std::make_unique<FrameAllocator>(maxFlightCount_);
 }
 
 void Renderer::bufferUniformData() {
@@ -232,42 +530,45 @@ void Renderer::bufferUniformData() {
     auto& ctx = Context::getInstance();
     float aspect = float(ctx.swapchainPtr->info.imageExtent.width) / ctx.swapchainPtr->info.imageExtent.height;
     MVP mvp;
-    mvp.modle = glm::translate(glm::mat4(1.f), glm::vec3(0, 0, -6)) * glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 1.f, 0.f));
-    // mvp.modle = glm::translate(glm::mat4(1.f), glm::vec3(0, 0, -3)) * glm::scale(glm::mat4(1.f), glm::vec3(0.1f, 0.1f, 0.1f));
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(0, 0, -6)) * glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 1.f, 0.f));
+    // glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(0, 0, -3)) * glm::scale(glm::mat4(1.f), glm::vec3(0.1f, 0.1f, 0.1f));
+    mvp.modle = model * positionTransform_;
     mvp.view = glm::lookAt(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
     mvp.proj = glm::perspective(glm::radians(45.f), aspect, 0.5f, 100.f);
     mvp.proj[1][1] *= -1;
-    for (int i = 0; i < uniformBuffers_.size(); ++ i) {
-        auto& buffer = uniformBuffers_[i];
-        memcpy(buffer->map, &mvp, sizeof(mvp));
-    }
+    mvp.texcoordTransform = texcoordTransform_;
+
+    // Meshlet bounds live in the model's object space
+    cullFrustum_ = Frustum::fromMatrix(mvp.proj * mvp.view * model);
+    cullCameraPos_ = glm::vec3(glm::inverse(mvp.view * model)[3]);
+    lodProjectionScale_ = std::abs(mvp.proj[1][1]) * ctx.swapchainPtr->info.imageExtent.height * 0.5f;
+    mvpOffset_ = frameUniforms_->push(mvp);
 }
 
 void Renderer::allocateDescriporSets() {
     auto& ctx = Context::getInstance();
     auto layouts = ctx.shaderManagerPtr->get(0)->getDescriptorSetLayouts();
     sets_.resize(maxFlightCount_);
-    for (int i = 0; i < sets_.size(); ++ i) {
+    for (auto& sets : sets_) {
         for (auto& layout : layouts) {
-            sets_[i].push_back(ctx.descriptorManagerPtr->allocateDescriptorSets({layout})[0]);
+            sets.push_back(ctx.descriptorManagerPtr->allocateDescriptorSets({layout})[0]);
         }
     }
 }
 
 void Renderer::updateSets() {
-    for (int i = 0; i < sets_.size(); ++ i) {
-        auto& set = sets_[i];
+    for (auto& set : sets_) {
 
         std::vector<vk::WriteDescriptorSet> writer(2);
 
-        // Buffer set
+        // Buffer set, the MVP's slice is picked by the dynamic offset
         vk::DescriptorBufferInfo bufferInfo;
         bufferInfo
-            .setBuffer(uniformBuffers_[i]->buffer)
+            .setBuffer(frameUniforms_->buffer())
             .setOffset(0)
-            .setRange(uniformBuffers_[i]->size);
+            .setRange(sizeof(MVP));
         writer[0]
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
             .setBufferInfo(bufferInfo)
             .setDstSet(set[0])
             .setDstBinding(0)
@@ -278,7 +579,7 @@ void Renderer::updateSets() {
         vk::DescriptorImageInfo imageInfo;
         imageInfo
             .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setImageView(Context::getInstance().textureManagerPtr->get(0)->view)
+            .setImageView(texture->view)
             .setSampler(sampler);
         writer[1]
             .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
@@ -293,9 +594,11 @@ void Renderer::updateSets() {
 }
 
 void Renderer::createTexture() {
-    // texture = Context::getInstance().textureManagerPtr->load(ROOT_PATH + "renderer/assets/images/hutao.png");
-    // texture = Context::getInstance().textureManagerPtr->load(ROOT_PATH + "renderer/assets/models/keqing/tex/cloth.png");
-    texture = Context::getInstance().textureManagerPtr->load(ROOT_PATH + "renderer/assets/models/Red/Red.png");
+    auto& textureManagerPtr = Context::getInstance().textureManagerPtr;
+    // textureHandle_ = textureManagerPtr->load(ROOT_PATH + "renderer/assets/images/hutao.png");
+    // textureHandle_ = textureManagerPtr->load(ROOT_PATH + "renderer/assets/models/keqing/tex/cloth.png");
+    textureHandle_ = textureManagerPtr->load(ROOT_PATH + "renderer/assets/models/Red/Red.png");
+    texture = textureManagerPtr->get(textureHandle_);
 }
 
 void Renderer::createSampler() {
@@ -310,7 +613,9 @@ void Renderer::createSampler() {
         .setBorderColor(vk::BorderColor::eIntOpaqueBlack)
         .setUnnormalizedCoordinates(vk::False)
         .setCompareEnable(vk::False)
-        .setMipmapMode(vk::SamplerMipmapMode::eLinear);
+        .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+        .setMinLod(0.f)
+        .setMaxLod(vk::LodClampNone);     // clamped by each texture's view to its own chain
     try {
         sampler = Context::getInstance().device.createSampler(createInfo);
     } catch (const std::exception &e) {
@@ -318,16 +623,4 @@ void Renderer::createSampler() {
     }
 }
 
-void Renderer::copyBuffer(vk::Buffer src, vk::Buffer dst, size_t srcOffset, size_t dstOffset, size_t size) {
-    auto& ctx = Context::getInstance();
-    ctx.cmdManagerPtr->exceuteCommand(ctx.graphicsQueue, [&](vk::CommandBuffer cmdBuf){
-        vk::BufferCopy region;
-        region
-            .setSrcOffset(srcOffset)
-            .setDstOffset(dstOffset)
-            .setSize(size);
-        cmdBuf.copyBuffer(src, dst, region);
-    });
-}
-
 }
\ No newline at end of file
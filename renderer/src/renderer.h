@@ -1,20 +1,38 @@
 #pragma once
 
+#include <span>
 #include "vulkan/vulkan.hpp"
 #include "buffer.h"
 #include "texture.h"
 #include "shader.h"
 #include "vertex.h"
+#include "meshlet.h"
+#include "mesh_simplifier.h"
+#include "model.h"
+#include "frustum_culler.h"
+#include "texture_streamer.h"
+#include "frame_allocator.h"
+#include "per_frame.h"
 
 namespace huahualib {
 
 class Renderer final {
 public:
+    // At most kMaxFramesInFlight
     Renderer(int maxFlightCount = 2);
     ~Renderer();
 
-    void bindVertices(const std::vector<Vertex>& vertices);
-    void bindIndices(const std::vector<uint32_t>& indices);
+    void bindVertices(std::span<const Vertex> vertices);
+    // Switches to the compact pipeline, the quantization is folded into the model matrix
+    void bindVertices(std::span<const CompactVertex> vertices, const VertexQuantization &quantization);
+    // Uploads 16-bit indices when every index fits, 32-bit otherwise
+    void bindIndices(std::span<const uint32_t> indices);
+    // Enables per-meshlet frustum and back-face culling, the bound indices must be in meshlet order
+    void bindMeshlets(std::span<const Meshlet> meshlets, std::span<const MeshletBounds> bounds);
+    // Draws the coarsest level whose error stays under maxPixelError on screen, the bound indices must hold all levels
+    void bindLods(std::span<const MeshLod> lods, const BoundingSphere &bounds, float maxPixelError = 1.f);
+    // Binds everything the model provides and draws it per submesh with its material's texture
+    void bindModel(const Model &model);
     void beginRender();
     void render();
     void endRender();
@@ -24,22 +42,59 @@ private:
     int maxFlightCount_;
     int curframe_;
     unsigned int curImageIndex_;
-    std::vector<vk::CommandBuffer> cmdBuffers_;
+    PerFrame<vk::CommandBuffer> cmdBuffers_;
 
-    std::vector<vk::Fence> fences_;
-    std::vector<vk::Semaphore> imageAvaliables_;
-    std::vector<vk::Semaphore> imageDrawFinsihs_;
+    PerFrame<vk::Fence> fences_;
+    PerFrame<vk::Semaphore> imageAvaliables_;
+    PerFrame<vk::Semaphore> imageDrawFinsihs_;
 
     std::unique_ptr<Buffer> vertexBuffer_;
     std::unique_ptr<Buffer> indexBuffer_;
+    vk::IndexType indexType_ = vk::IndexType::eUint32;
+    VertexFormat vertexFormat_ = VertexFormat::eFull;
+    glm::mat4 positionTransform_ = glm::mat4(1.f);
+    glm::vec4 texcoordTransform_ = glm::vec4(1.f, 1.f, 0.f, 0.f);
 
-    std::vector<std::unique_ptr<Buffer>> uniformBuffers_;
+    std::vector<Meshlet> meshlets_;
+    std::vector<MeshletBounds> meshletBounds_;
+    Frustum cullFrustum_;           // object space, from the current MVP
+    glm::vec3 cullCameraPos_;       // object space
+
+    // One submesh of one LOD level, drawn with the texture in materialSets_[textureSet]
+    struct DrawRecord {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        int32_t vertexOffset;       // added to the indices, non-zero when they were rebased to 16 bits
+        uint32_t submesh;           // index into the submesh bounds
+        uint32_t textureSet;
+        uint32_t firstMeshlet;      // level 0 only, meshlets inside the index range
+        uint32_t meshletCount;
+    };
+
+    std::vector<std::vector<DrawRecord>> draws_;    // per LOD level, sorted by textureSet
+    std::unique_ptr<TextureStreamer> streamer_;
+    std::vector<TextureStreamer::Handle> materialHandles_;
+    std::vector<std::unique_ptr<Texture>> atlasTextures_;     // one per page of the model's atlas
+    PerFrame<std::vector<vk::DescriptorSet>> materialSets_;     // [frame][set], set 1 of the pipeline layout
+    PerFrame<std::vector<uint32_t>> materialGenerations_;       // streamer generation each set was written with
+    std::vector<BoundingSphere> submeshSpheres_;
+    FrustumCuller submeshCuller_;
+    std::vector<uint8_t> submeshVisible_;
+
+    std::vector<MeshLod> lods_;
+    BoundingSphere lodBounds_;
+    float lodMaxPixelError_ = 1.f;
+    float lodProjectionScale_ = 1.f; // pixels per unit at distance 1
+
+    std::unique_ptr<FrameAllocator> frameUniforms_;    // set 0 binding 0, dynamic
+    uint32_t mvpOffset_ = 0;
     std::vector<std::unique_ptr<Buffer>> uniformBuffersVertex_;
 
-    std::vector<std::vector<vk::DescriptorSet>> sets_;
+    PerFrame<std::vector<vk::DescriptorSet>> sets_;
 
     Image* depthImage;
 
+    TextureHandle textureHandle_;
     Texture* texture;
     vk::Sampler sampler;
 
@@ -49,9 +104,9 @@ private:
     void createFance();
     void createCommandBuffers();
     void createVertexBuffer(size_t size);
-    void bufferVertexData(const std::vector<Vertex>& vertices);
+    void bufferVertexData(std::span<const std::byte> vertices);
     void createIndexBuffer(size_t size);
-    void bufferIndexData(const std::vector<uint32_t>& indices);
+    void bufferIndexData(std::span<const std::byte> indices);
     void createUniformBuffer();
     void bufferUniformData();
     void allocateDescriporSets();
@@ -59,7 +114,12 @@ private:
     void createTexture();
     void createSampler();
 
-    void copyBuffer(vk::Buffer src, vk::Buffer dst, size_t srcOffset, size_t dstOffset, size_t size);
+    void bindMaterials(const Model &model);
+    void writeMaterialSet(vk::DescriptorSet set, Texture* setTexture);
+    void refreshMaterialSets();
+    void bindDrawIndices(std::span<const uint32_t> indices);
+    void drawMeshlets(vk::CommandBuffer cmdBuffer, uint32_t firstMeshlet, uint32_t meshletCount, int32_t vertexOffset);
+
 };
 
 
@@ -59,7 +59,7 @@ void Shader::initDescriptorSetLayouts() {
     uboBinding
             .setBinding(0)
             .setDescriptorCount(1)
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
             .setStageFlags(vk::ShaderStageFlagBits::eVertex);
 
     setLayoutInfo.setBindings(uboBinding);
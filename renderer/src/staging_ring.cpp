@@ -0,0 +1,92 @@
+#include <optional>
+#include "staging_ring.h"
+#include "context.h"
+
+namespace huahualib {
+
+StagingRing::StagingRing(vk::DeviceSize size): size_(size) {
+    buffer_ = std::make_unique<Buffer>(size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+StagingRing::~StagingRing() {
+    // Whatever is still in flight has to finish before the buffer goes away
+    while (!entries_.empty() && waitOldest()) {}
+}
+
+StagingRing::Region StagingRing::allocate(const void* owner, vk::DeviceSize size, vk::DeviceSize alignment) {
+    if (size == 0 || size > size_) {
+        return {};
+    }
+
+    while (true) {
+        if (entries_.empty()) {
+            head_ = 0;
+        }
+        auto aligned = (head_ + alignment - 1) / alignment * alignment;
+        auto oldest = tail();
+
+        // Used space is [tail, head) until it wraps, then [tail, size) and [0, head)
+        bool wrapped = !entries_.empty() && head_ <= oldest;
+        std::optional<vk::DeviceSize> offset;
+        if (!wrapped && aligned + size <= size_) {
+            offset = aligned;
+        } else if (!wrapped && size <= oldest) {
+            offset = 0;     // the rest of the buffer becomes padding of this region
+        } else if (wrapped && aligned + size <= oldest) {
+            offset = aligned;
+        }
+
+        if (offset) {
+            entries_.push_back({owner, head_, *offset + size, 0});
+            head_ = *offset + size;
+
+            Region region;
+            region.buffer = buffer_->buffer;
+            region.offset = *offset;
+            region.size = size;
+            region.map = static_cast<uint8_t*>(buffer_->map) + *offset;
+            return region;
+        }
+
+        // Free what has finished, otherwise wait for the oldest submit unless nobody submitted it yet
+        auto count = entries_.size();
+        reclaim();
+        if (entries_.size() == count && !waitOldest()) {
+            return {};
+        }
+    }
+}
+
+void StagingRing::submitted(const void* owner, UploadToken token) {
+    for (auto& entry : entries_) {
+        if (entry.owner == owner && entry.token == 0 && !entry.done) {
+            entry.token = token;
+        }
+    }
+}
+
+void StagingRing::reclaim() {
+    auto reached = Context::getInstance().uploadQueuePtr->completed();
+    for (auto& entry : entries_) {
+        if (entry.token != 0 && !entry.done && entry.token <= reached) {
+            entry.done = true;
+        }
+    }
+    while (!entries_.empty() && entries_.front().done) {
+        entries_.pop_front();
+    }
+}
+
+bool StagingRing::waitOldest() {
+    auto token = entries_.front().token;
+    if (token == 0) {
+        return false;
+    }
+    Context::getInstance().uploadQueuePtr->wait(token);
+    reclaim();
+    return true;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include "vulkan/vulkan.hpp"
+#include "buffer.h"
+#include "upload_queue.h"
+
+namespace huahualib {
+
+// One persistently mapped host visible buffer that every upload stages through. Regions are handed out
+// in ring order and belong to an owner (an upload batch) until it submits them to the upload queue, they
+// are reused once that submit's token is reached. Out of order submits only hold space until the older regions finish.
+class StagingRing final {
+public:
+    struct Region {
+        vk::Buffer buffer;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        void* map = nullptr;
+
+        explicit operator bool() const { return map != nullptr; }
+    };
+
+    StagingRing(vk::DeviceSize size = 64ull << 20);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // Waits for submitted regions when needed. Returns an empty region when the space is held by regions
+    // that are not submitted yet, the owner should submit its own and try again.
+    Region allocate(const void* owner, vk::DeviceSize size, vk::DeviceSize alignment = 16);
+    // Everything owner allocated since its last submit is free again once token is reached
+    void submitted(const void* owner, UploadToken token);
+    // Frees regions whose token is reached
+    void reclaim();
+
+    vk::DeviceSize size() const { return size_; }
+    // Largest piece callers should stage at once, bigger uploads are split so several can be in flight
+    vk::DeviceSize chunkSize() const { return size_ / 4; }
+
+private:
+    struct Entry {
+        const void* owner;
+        vk::DeviceSize begin;       // including the padding in front of the region
+        vk::DeviceSize end;
+        UploadToken token;          // 0 until submitted
+        bool done = false;
+    };
+
+    std::unique_ptr<Buffer> buffer_;
+    vk::DeviceSize size_;
+    vk::DeviceSize head_ = 0;       // next free byte
+    std::deque<Entry> entries_;     // oldest first
+
+    vk::DeviceSize tail() const { return entries_.empty() ? head_ : entries_.front().begin; }
+    bool waitOldest();
+};
+
+}
@@ -23,8 +23,8 @@ Swapchain::~Swapchain() {
     }
 
     device.destroyImageView(depthImageView);
-    device.freeMemory(depthImageMem);
     device.destroyImage(depthImage);
+    Context::getInstance().memoryAllocatorPtr->free(depthImageMem);
 
     device.destroySwapchainKHR(swapchain);
 }
@@ -138,7 +138,7 @@ void Swapchain::createDepthSource() {
         depthImage, vk::Format::eD32Sfloat, 
         vk::ImageAspectFlagBits::eDepth);
 
-    ctx.cmdManagerPtr->exceuteCommand(ctx.graphicsQueue, [&](vk::CommandBuffer cmdBuf) -> void {
+    ctx.cmdManagerPtr->exceuteCommand([&](vk::CommandBuffer cmdBuf) -> void {
         vk::ImageMemoryBarrier barrier;
         vk::ImageSubresourceRange range;
         range
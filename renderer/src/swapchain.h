@@ -24,7 +24,7 @@ public:
 
     vk::Image depthImage;
     vk::ImageView depthImageView;
-    vk::DeviceMemory depthImageMem;
+    MemoryAllocation depthImageMem;
 
     std::vector<vk::Framebuffer> frameBuffers;
 
@@ -1,6 +1,14 @@
 #include "texture.h"
 #include "context.h"
 #include "descriptor_manager.h"
+#include "mapped_file.h"
+#include "tool.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+#include <utility>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -9,61 +17,169 @@ namespace huahualib {
 /*******************************************************
 *                        Texture                       *
 *******************************************************/
-Texture::Texture(std::string_view filename) {
-    int w, h, channel;
-    stbi_uc* pexels = stbi_load(filename.data(), &w, &h, &channel, STBI_rgb_alpha);
+Texture::Texture(std::string_view filename, TextureUsage usage) {
+    UploadBatch batch;
+    load(filename, batch, usage);
+    batch.flush();
+}
 
-    if (!pexels) {
-        throw std::runtime_error("Failed to load image!\n");
-    }
+Texture::Texture(std::string_view filename, UploadBatch& batch, TextureUsage usage) {
+    load(filename, batch, usage);
+}
 
-    init(pexels, (uint32_t)w, (uint32_t)h);
+Texture::Texture(void* data, uint32_t w, uint32_t h) {
+    UploadBatch batch;
+    init(static_cast<const uint8_t*>(data), w, h, 4, TextureUsage::eColor, batch);
+    batch.flush();
+}
 
-    stbi_image_free(pexels);
+Texture::Texture(void* data, uint32_t w, uint32_t h, UploadBatch& batch) {
+    init(static_cast<const uint8_t*>(data), w, h, 4, TextureUsage::eColor, batch);
 }
 
-Texture::Texture(void* data, uint32_t w, uint32_t h) {
-    init(data, w, h);
+Texture::Texture(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, TextureUsage usage, UploadBatch& batch) {
+    init(pixels, w, h, channels, usage, batch);
+}
+
+Texture::Texture(vk::Format format, const uint8_t* data, std::span<const MipLevel> levels, UploadBatch& batch) {
+    initLevels(format, data, levels, batch);
 }
 
 Texture::~Texture() {
     auto& ctx = Context::getInstance();
     ctx.device.destroyImageView(view);
-    ctx.device.freeMemory(memory);
     ctx.device.destroyImage(image);
+    ctx.memoryAllocatorPtr->free(memory);
+}
+
+vk::Format Texture::pixelFormat(uint32_t &channels, TextureUsage usage) {
+    bool srgb = usage == TextureUsage::eColor;
+    // Gray and alpha color goes to RGBA, in RG8 sRGB the alpha would be decoded as a color channel
+    if (channels == 1 || (channels == 2 && !srgb)) {
+        vk::Format narrow = channels == 1 ? (srgb ? vk::Format::eR8Srgb : vk::Format::eR8Unorm) : vk::Format::eR8G8Unorm;
+        // sRGB R8 and RG8 are optional for sampling
+        auto properties = Context::getInstance().phyDevice.getFormatProperties(narrow);
+        auto required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        if ((properties.optimalTilingFeatures & required) == required) {
+            return narrow;
+        }
+    }
+    channels = 4;
+    return srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+}
+
+void Texture::load(std::string_view filename, UploadBatch& batch, TextureUsage usage) {
+    if (filename.ends_with(".ktx2")) {
+        initKtx2(Ktx2File(std::string(filename)), batch);
+        return;
+    }
+
+    // stb expands gray to RGBA itself when pixelFormat picks RGBA, RGB is always expanded
+    int w, h, channel;
+    if (!stbi_info(filename.data(), &w, &h, &channel)) {
+        throw std::runtime_error("Failed to load image!\n");
+    }
+    uint32_t channels = channel <= 2 ? (uint32_t)channel : 4;
+    pixelFormat(channels, usage);
+    stbi_uc* pexels = stbi_load(filename.data(), &w, &h, &channel, (int)channels);
+
+    if (!pexels) {
+        throw std::runtime_error("Failed to load image!\n");
+    }
+
+    init(pexels, (uint32_t)w, (uint32_t)h, channels, usage, batch);
+
+    stbi_image_free(pexels);
 }
 
-void Texture::init(void* data, uint32_t w, uint32_t h) {
-    const uint32_t size = w * h * 4;
-    std::unique_ptr<Buffer> buffer(new Buffer(
-        size, 
-        vk::BufferUsageFlagBits::eTransferSrc, 
-        vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible
-    ));
+void Texture::init(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, TextureUsage usage, UploadBatch& batch) {
+    if (channels != 1 && channels != 2 && channels != 4) {
+        throw std::runtime_error("Failed to create texture, only 1, 2 or 4 channels are supported!\n");
+    }
+
+    uint32_t stored = channels;
+    format = pixelFormat(stored, usage);
+    std::vector<uint8_t> expanded;
+    if (stored != channels) {
+        // Gray to gray RGB, the second channel is alpha
+        expanded.resize(4 * (size_t)w * h);
+        for (size_t i = 0; i < (size_t)w * h; ++ i) {
+            uint8_t gray = pixels[channels * i];
+            expanded[4 * i + 0] = gray;
+            expanded[4 * i + 1] = gray;
+            expanded[4 * i + 2] = gray;
+            expanded[4 * i + 3] = channels == 2 ? pixels[channels * i + 1] : 255;
+        }
+        pixels = expanded.data();
+        channels = stored;
+    }
 
-    memcpy(buffer->map, data, size);
+    // The GPU blits the chain when the format can be linearly filtered as a blit source,
+    // otherwise it is built on the CPU and uploaded with level 0
+    mipLevels = mipLevelCount(w, h);
+    bool gpuMipmaps = mipLevels > 1 && supportLinearBlit(format);
+
+    std::vector<uint8_t> chain;
+    std::vector<MipLevel> levels;
+    if (gpuMipmaps) {
+        levels.push_back({0, w, h});
+    } else {
+        levels = buildMipChain(pixels, w, h, channels, usage == TextureUsage::eColor, chain);
+        pixels = chain.data();
+    }
 
     createImage(w, h);
     allocMemory();
     createImageView();
 
-    transitionImageLayoutFromUndefineToDst();
-    transformDataToImage(*buffer, w, h);
-    transitionImageLayoutFromDstToOptimal();
+    transitionImageLayoutFromUndefineToDst(batch.commandBuffer());
+    batch.copyToImage(image, format, pixels, levels);
+    batch.releaseImage(image, mipLevels);
+    if (gpuMipmaps) {
+        generateMipmaps(batch.graphicsCommandBuffer(), w, h);
+    } else {
+        transitionImageLayoutFromDstToOptimal(batch.graphicsCommandBuffer());
+    }
 
 }
 
+void Texture::initKtx2(const Ktx2File& ktx, UploadBatch& batch) {
+    if (!ktx.valid()) {
+        throw std::runtime_error("Failed to load ktx2 image!\n");
+    }
+    initLevels(ktx.format(), ktx.data(), ktx.levels(), batch);
+}
+
+void Texture::initLevels(vk::Format levelFormat, const uint8_t* data, std::span<const MipLevel> levels, UploadBatch& batch) {
+    auto properties = Context::getInstance().phyDevice.getFormatProperties(levelFormat);
+    if (!(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage)) {
+        throw std::runtime_error("Failed to create texture, format is not supported by the device!\n");
+    }
+
+    format = levelFormat;
+    mipLevels = (uint32_t)levels.size();
+
+    createImage(levels[0].width, levels[0].height);
+    allocMemory();
+    createImageView();
+
+    transitionImageLayoutFromUndefineToDst(batch.commandBuffer());
+    batch.copyToImage(image, format, data, levels);
+    batch.releaseImage(image, mipLevels);
+    transitionImageLayoutFromDstToOptimal(batch.graphicsCommandBuffer());
+}
+
 void Texture::createImage(uint32_t w, uint32_t h) {
     vk::ImageCreateInfo imageInfo;
     imageInfo
         .setImageType(vk::ImageType::e2D)
         .setArrayLayers(1)
-        .setMipLevels(1)
+        .setMipLevels(mipLevels)
         .setExtent({w, h, 1})
-        .setFormat(vk::Format::eR8G8B8A8Srgb)
+        .setFormat(format)
         .setTiling(vk::ImageTiling::eOptimal)
         .setInitialLayout(vk::ImageLayout::eUndefined)
-        .setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled)
+        .setUsage(vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled)
         .setSamples(vk::SampleCountFlagBits::e1);
     try {
         image = Context::getInstance().device.createImage(imageInfo);
@@ -75,19 +191,23 @@ void Texture::createImage(uint32_t w, uint32_t h) {
 void Texture::createImageView() {
     vk::ImageViewCreateInfo viewInfo;
     vk::ComponentMapping mapping;
+    // Gray color images read as gray RGB, data keeps its channels where the shader expects them
+    if (format == vk::Format::eR8Srgb) {
+        mapping.setR(vk::ComponentSwizzle::eR).setG(vk::ComponentSwizzle::eR).setB(vk::ComponentSwizzle::eR).setA(vk::ComponentSwizzle::eOne);
+    }
     vk::ImageSubresourceRange range;
     range
         .setAspectMask(vk::ImageAspectFlagBits::eColor)
         .setBaseArrayLayer(0)
         .setBaseMipLevel(0)
         .setLayerCount(1)
-        .setLevelCount(1);
+        .setLevelCount(mipLevels);
     viewInfo
         .setImage(image)
         .setComponents(mapping)
         .setSubresourceRange(range)
         .setViewType(vk::ImageViewType::e2D)
-        .setFormat(vk::Format::eR8G8B8A8Srgb);
+        .setFormat(format);
     try {
         view = Context::getInstance().device.createImageView(viewInfo);
     } catch (const std::exception &e) {
@@ -96,104 +216,114 @@ void Texture::createImageView() {
 }
 
 void Texture::allocMemory() {
-    auto &device = Context::getInstance().device;
-    auto requirements = device.getImageMemoryRequirements(image);
-    vk::MemoryAllocateInfo allocInfo;
-    uint32_t index = queryImageMemoryIndex(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
-    allocInfo
-        .setMemoryTypeIndex(index)
-        .setAllocationSize(requirements.size);
-    try {
-        memory = device.allocateMemory(allocInfo);
-    } catch (const std::exception &e) {
-        throw std::runtime_error("Failed to allocate image memory!\n");
-    }
+    auto& ctx = Context::getInstance();
+    auto requirements = ctx.device.getImageMemoryRequirements(image);
+    memorySize = requirements.size;
+    memory = ctx.memoryAllocatorPtr->allocate(requirements, vk::MemoryPropertyFlagBits::eDeviceLocal, {}, ResourceTiling::eOptimal);
+    ctx.device.bindImageMemory(image, memory.memory, memory.offset);
+}
 
-    device.bindImageMemory(image, memory, 0);
+void Texture::transitionImageLayoutFromUndefineToDst(vk::CommandBuffer cmdBuf) {
+    vk::ImageMemoryBarrier barrier;
+    vk::ImageSubresourceRange range;
+    range
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setLayerCount(1)
+        .setBaseArrayLayer(0)
+        .setLevelCount(mipLevels)
+        .setBaseMipLevel(0);
+    barrier
+        .setImage(image)
+        .setSubresourceRange(range)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
 }
 
-uint32_t Texture::queryImageMemoryIndex(size_t memTypeBits, vk::MemoryPropertyFlags memProperty) {
-    auto properties = Context::getInstance().phyDevice.getMemoryProperties();
-    for (int i = 0; i < properties.memoryTypeCount; ++ i) {
-        if ((i << 1) & memTypeBits && properties.memoryTypes[i].propertyFlags & memProperty) {
-            return i;
-        }
-    }
+void Texture::transitionImageLayoutFromDstToOptimal(vk::CommandBuffer cmdBuf) {
+    vk::ImageMemoryBarrier barrier;
+    vk::ImageSubresourceRange range;
+    range
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setLayerCount(1)
+        .setBaseArrayLayer(0)
+        .setLevelCount(mipLevels)
+        .setBaseMipLevel(0);
+    barrier
+        .setImage(image)
+        .setSubresourceRange(range)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
+}
 
-    return 0;
+bool Texture::supportLinearBlit(vk::Format format) {
+    auto properties = Context::getInstance().phyDevice.getFormatProperties(format);
+    auto required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (properties.optimalTilingFeatures & required) == required;
 }
 
-void Texture::transitionImageLayoutFromUndefineToDst() {
-    auto cmdFunc = [&](vk::CommandBuffer cmdBuf) {
-        vk::ImageMemoryBarrier barrier;
-        vk::ImageSubresourceRange range;
-        range
-            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-            .setLayerCount(1)
-            .setBaseArrayLayer(0)
-            .setLevelCount(1)
-            .setBaseMipLevel(0);
-        barrier
-            .setImage(image)
-            .setSubresourceRange(range)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
-    };
+void Texture::generateMipmaps(vk::CommandBuffer cmdBuf, uint32_t w, uint32_t h) {
+    // Every level is blitted from the one above it, which then moves on to shader read.
+    // Expects all levels in transfer dst with level 0 filled.
+    vk::ImageMemoryBarrier barrier;
+    vk::ImageSubresourceRange range;
+    range
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setLayerCount(1)
+        .setBaseArrayLayer(0)
+        .setLevelCount(1);
+    barrier
+        .setImage(image)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
 
-    auto& ctx = Context::getInstance();
-    ctx.cmdManagerPtr->exceuteCommand(ctx.graphicsQueue, cmdFunc);
-}
-
-void Texture::transitionImageLayoutFromDstToOptimal() {
-    auto cmdFunc = [&](vk::CommandBuffer cmdBuf) {
-        vk::ImageMemoryBarrier barrier;
-        vk::ImageSubresourceRange range;
-        range
-            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-            .setLayerCount(1)
-            .setBaseArrayLayer(0)
-            .setLevelCount(1)
-            .setBaseMipLevel(0);
+    int32_t mipWidth = (int32_t)w, mipHeight = (int32_t)h;
+    for (uint32_t i = 1; i < mipLevels; ++ i) {
+        range.setBaseMipLevel(i - 1);
         barrier
-            .setImage(image)
             .setSubresourceRange(range)
             .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+        int32_t nextWidth = std::max(1, mipWidth / 2), nextHeight = std::max(1, mipHeight / 2);
+        vk::ImageBlit blit;
+        blit
+            .setSrcSubresource({vk::ImageAspectFlagBits::eColor, i - 1, 0, 1})
+            .setSrcOffsets({vk::Offset3D(0, 0, 0), vk::Offset3D(mipWidth, mipHeight, 1)})
+            .setDstSubresource({vk::ImageAspectFlagBits::eColor, i, 0, 1})
+            .setDstOffsets({vk::Offset3D(0, 0, 0), vk::Offset3D(nextWidth, nextHeight, 1)});
+        cmdBuf.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+        barrier
+            .setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
             .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
             .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
         cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
-    };
 
-    auto& ctx = Context::getInstance();
-    ctx.cmdManagerPtr->exceuteCommand(ctx.graphicsQueue, cmdFunc);
-}
-
-void Texture::transformDataToImage(Buffer& buffer, uint32_t w, uint32_t h) {
-    auto cmdFunc = [&](vk::CommandBuffer cmdBuf) {
-        vk::ImageSubresourceLayers subsource;
-        vk::BufferImageCopy region;
-        subsource
-            .setBaseArrayLayer(0)
-            .setLayerCount(1)
-            .setMipLevel(0)
-            .setAspectMask(vk::ImageAspectFlagBits::eColor);
-        region
-            .setImageSubresource(subsource)
-            .setBufferImageHeight(0)
-            .setBufferRowLength(0)
-            .setBufferOffset(0)
-            .setImageOffset(0)
-            .setImageExtent({w, h, 1});
-        cmdBuf.copyBufferToImage(buffer.buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
-    };
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
 
-    auto& ctx = Context::getInstance();
-    ctx.cmdManagerPtr->exceuteCommand(ctx.graphicsQueue, cmdFunc);
+    range.setBaseMipLevel(mipLevels - 1);
+    barrier
+        .setSubresourceRange(range)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
 }
 
 /*******************************************************
@@ -201,38 +331,264 @@ void Texture::transformDataToImage(Buffer& buffer, uint32_t w, uint32_t h) {
 *******************************************************/
 std::unique_ptr<TextureManager> TextureManager::instance_ = nullptr;
 
-Texture* TextureManager::load(const std::string& filename) {
-    datas_.push_back(std::make_unique<Texture>(filename));
-    return datas_.back().get();
+TextureManager::TextureManager(uint32_t framesInFlight): framesInFlight_(framesInFlight) {}
+
+TextureHandle TextureManager::load(const std::string& filename, TextureUsage usage) {
+    UploadBatch batch;
+    auto handle = load(filename, batch, usage);
+    batch.flush();
+    return handle;
 }
 
-Texture* TextureManager::create(void* data, uint32_t w, uint32_t h) {
-    datas_.push_back(std::make_unique<Texture>(data, w, h));
-    return datas_.back().get();
+TextureHandle TextureManager::load(const std::string& filename, UploadBatch& batch, TextureUsage usage) {
+    auto path = canonicalPath(filename);
+    if (auto it = pathSlots_.find(pathKey(path, usage)); it != pathSlots_.end()) {
+        return acquire({it->second, slots_[it->second].generation});
+    }
+
+    auto decoded = decode(path, usage, true);
+    return upload(decoded, batch);
 }
 
-Texture* TextureManager::get(int i) const {
-    return datas_[i].get();
+std::vector<TextureHandle> TextureManager::loadBatch(std::span<const std::string> filenames, TextureUsage usage, size_t flushBytes) {
+    auto& pool = ThreadPool::instance();
+    std::vector<TextureHandle> handles(filenames.size());
+    std::vector<std::string> keys(filenames.size());
+    std::vector<std::future<Decoded>> decodes(filenames.size());
+    std::unordered_set<std::string> queued;
+
+    // Paths already loaded, or repeated in the batch, are not decoded again
+    for (size_t i = 0; i < filenames.size(); ++ i) {
+        auto path = canonicalPath(filenames[i]);
+        keys[i] = pathKey(path, usage);
+        if (pathSlots_.contains(keys[i]) || !queued.insert(keys[i]).second) continue;
+        decodes[i] = pool.submit([path, usage]() { return decode(path, usage, true); });
+    }
+
+    // Uploads in order, the pool keeps decoding while the earlier images are staged and copied
+    UploadBatch batch;
+    size_t recorded = 0;
+    for (size_t i = 0; i < filenames.size(); ++ i) {
+        try {
+            if (decodes[i].valid()) {
+                auto decoded = decodes[i].get();
+                handles[i] = upload(decoded, batch);
+                recorded += get(handles[i])->memorySize;
+            } else if (auto it = pathSlots_.find(keys[i]); it != pathSlots_.end()) {
+                handles[i] = acquire({it->second, slots_[it->second].generation});
+            }
+        } catch (const std::exception &e) {
+            std::cout << e.what() << "Load texture " + filenames[i] + " failed!" << std::endl;
+        }
+
+        if (recorded >= flushBytes) {
+            batch.flush();
+            recorded = 0;
+        }
+    }
+    batch.flush();
+
+    return handles;
 }
 
-int TextureManager::size() {
-    return datas_.size();
+std::string TextureManager::canonicalPath(const std::string& filename) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(filename, ec);
+    return ec ? filename : canonical.string();
 }
 
-void TextureManager::destroy(Texture* texture) {
-    auto it = std::find_if(datas_.begin(), datas_.end(), [&](const std::unique_ptr<Texture>& t) {
-        return t.get() == texture;
-    });
+std::string TextureManager::pathKey(const std::string& path, TextureUsage usage) {
+    return usage == TextureUsage::eColor ? path : path + "|data";
+}
+
+std::string TextureManager::compressedSibling(const std::string& path) {
+    std::filesystem::path compressed(path);
+    compressed.replace_extension(".ktx2");
+    std::error_code ec;
+    if (compressed.string() != path && std::filesystem::exists(compressed, ec)) {
+        return compressed.string();
+    }
+    return path;
+}
+
+TextureManager::Decoded TextureManager::decode(const std::string& path, TextureUsage usage, bool preferKtx2) {
+    Decoded decoded;
+    decoded.key = pathKey(path, usage);
+    decoded.path = path;
+    decoded.filename = path;
+    decoded.usage = usage;
+
+    // A .ktx2 written by texture_compressor next to the image is preferred, the image is the fallback
+    if (preferKtx2) {
+        decoded.filename = compressedSibling(path);
+    }
+
+    MappedFile file(decoded.filename);
+    if (!file.valid()) {
+        throw std::runtime_error("Failed to open image!\n");
+    }
+    // Hashing the mapped file costs little next to decoding it and catches copies stored under other names
+    decoded.contentHash = hashBytes(&usage, sizeof(usage), hashBytes(file.data(), file.size()));
+    decoded.contentSize = file.size();
+    if (decoded.filename.ends_with(".ktx2")) {
+        return decoded;
+    }
 
-    if (it != datas_.end()) {
-        Context::getInstance().device.waitIdle();
-        datas_.erase(it);
-        return ;
+    // stb expands gray to RGBA itself when pixelFormat picks RGBA, RGB is always expanded
+    auto source = static_cast<const stbi_uc*>(file.data());
+    int w, h, channel;
+    if (!stbi_info_from_memory(source, (int)file.size(), &w, &h, &channel)) {
+        throw std::runtime_error("Failed to load image!\n");
+    }
+    decoded.channels = channel <= 2 ? (uint32_t)channel : 4;
+    Texture::pixelFormat(decoded.channels, usage);
+    stbi_uc* pexels = stbi_load_from_memory(source, (int)file.size(), &w, &h, &channel, (int)decoded.channels);
+    if (!pexels) {
+        throw std::runtime_error("Failed to load image!\n");
     }
+    decoded.pixels.reset(pexels, stbi_image_free);
+    decoded.width = (uint32_t)w;
+    decoded.height = (uint32_t)h;
+    return decoded;
+}
+
+TextureHandle TextureManager::upload(Decoded& decoded, UploadBatch& batch) {
+    // The hash only shares a texture when the size and dimensions agree too
+    if (auto it = contentSlots_.find(decoded.contentHash); it != contentSlots_.end()) {
+        auto& slot = slots_[it->second];
+        if (slot.contentSize == decoded.contentSize && slot.width == decoded.width && slot.height == decoded.height) {
+            slot.keys.push_back(decoded.key);
+            pathSlots_.emplace(decoded.key, it->second);
+            return acquire({it->second, slot.generation});
+        }
+    }
+
+    if (decoded.pixels) {
+        auto texture = std::make_unique<Texture>(decoded.pixels.get(), decoded.width, decoded.height, decoded.channels, decoded.usage, batch);
+        return insert(std::move(texture), &decoded);
+    }
+
+    try {
+        return insert(std::make_unique<Texture>(decoded.filename, batch), &decoded);
+    } catch (const std::exception &e) {
+        if (decoded.filename == decoded.path) throw;
+        std::cout << e.what() << "Fall back to " + decoded.path << std::endl;
+    }
+    auto image = decode(decoded.path, decoded.usage, false);
+    return upload(image, batch);
+}
+
+TextureHandle TextureManager::create(void* data, uint32_t w, uint32_t h) {
+    return insert(std::make_unique<Texture>(data, w, h), nullptr);
+}
+
+TextureHandle TextureManager::create(void* data, uint32_t w, uint32_t h, UploadBatch& batch) {
+    return insert(std::make_unique<Texture>(data, w, h, batch), nullptr);
+}
+
+TextureHandle TextureManager::insert(std::unique_ptr<Texture> texture, const Decoded* decoded) {
+    uint32_t index;
+    if (!freeSlots_.empty()) {
+        index = freeSlots_.back();
+        freeSlots_.pop_back();
+    } else {
+        index = (uint32_t)slots_.size();
+        slots_.emplace_back();
+    }
+
+    auto& slot = slots_[index];
+    slot.texture = std::move(texture);
+    slot.refCount = 1;
+    slot.contentHash = decoded ? decoded->contentHash : 0;
+    slot.contentSize = decoded ? decoded->contentSize : 0;
+    slot.width = decoded ? decoded->width : 0;
+    slot.height = decoded ? decoded->height : 0;
+    if (decoded) {
+        slot.keys.push_back(decoded->key);
+        pathSlots_[decoded->key] = index;
+        contentSlots_.try_emplace(decoded->contentHash, index);
+    }
+    ++ count_;
+    return {index, slot.generation};
+}
+
+const TextureManager::Slot* TextureManager::find(TextureHandle handle) const {
+    if (handle.index >= slots_.size()) return nullptr;
+    const auto& slot = slots_[handle.index];
+    return slot.texture && slot.generation == handle.generation ? &slot : nullptr;
+}
+
+TextureManager::Slot* TextureManager::find(TextureHandle handle) {
+    return const_cast<Slot*>(std::as_const(*this).find(handle));
+}
+
+TextureHandle TextureManager::acquire(TextureHandle handle) {
+    if (auto slot = find(handle)) {
+        ++ slot->refCount;
+        return handle;
+    }
+    return {};
+}
+
+void TextureManager::release(TextureHandle handle) {
+    auto slot = find(handle);
+    if (!slot || -- slot->refCount > 0) return;
+
+    for (const auto& key : slot->keys) {
+        pathSlots_.erase(key);
+    }
+    if (auto it = contentSlots_.find(slot->contentHash); !slot->keys.empty() && it != contentSlots_.end() && it->second == handle.index) {
+        contentSlots_.erase(it);
+    }
+    slot->keys.clear();
+
+    // Frames in flight may still sample it
+    retired_.push_back({std::move(slot->texture), frame_});
+    ++ slot->generation;
+    freeSlots_.push_back(handle.index);
+    -- count_;
+}
+
+Texture* TextureManager::get(TextureHandle handle) const {
+    auto slot = find(handle);
+    return slot ? slot->texture.get() : nullptr;
+}
+
+uint32_t TextureManager::refCount(TextureHandle handle) const {
+    auto slot = find(handle);
+    return slot ? slot->refCount : 0;
+}
+
+int TextureManager::size() const {
+    return count_;
 }
 
 void TextureManager::clear() {
-    datas_.clear();
+    // Uploads of these textures may still be in flight
+    auto& ctx = Context::getInstance();
+    ctx.uploadQueuePtr->wait(ctx.uploadQueuePtr->lastSubmitted());
+
+    // Slots are kept so outstanding handles keep failing to resolve
+    for (uint32_t i = 0; i < slots_.size(); ++ i) {
+        auto& slot = slots_[i];
+        if (!slot.texture) continue;
+        slot.texture.reset();
+        slot.keys.clear();
+        slot.refCount = 0;
+        ++ slot.generation;
+        freeSlots_.push_back(i);
+    }
+    pathSlots_.clear();
+    contentSlots_.clear();
+    count_ = 0;
+}
+
+void TextureManager::update() {
+    ++ frame_;
+
+    std::erase_if(retired_, [&](const Retired &retired) {
+        return retired.frame + framesInFlight_ < frame_;
+    });
 }
 
 }
\ No newline at end of file
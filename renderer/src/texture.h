@@ -1,38 +1,83 @@
 #pragma once
 
+#include <limits>
+#include <memory>
+#include <span>
 #include <string_view>
+#include <unordered_map>
 #include "vulkan/vulkan.hpp"
 #include "buffer.h"
 #include "image.h"
+#include "mipmap.h"
+#include "ktx2.h"
+#include "upload_batch.h"
 
 namespace huahualib {
 
+// How decoded images are stored, color is sampled as sRGB and data (normals, roughness, masks) as is
+enum class TextureUsage : uint32_t {
+    eColor,
+    eData,
+};
+
 class Texture final {
 public:
     friend class TextureManager;
     vk::Image image;
     vk::ImageView view;
-    vk::DeviceMemory memory;
+    MemoryAllocation memory;
+    uint32_t mipLevels = 1;     // full chain down to 1x1, the view covers all of them
+    vk::Format format = vk::Format::eR8G8B8A8Srgb;
+    vk::DeviceSize memorySize = 0;
 
-    Texture(std::string_view filename);
+    // .ktx2 files are uploaded as stored, block compressed with their own mips. Other images keep
+    // their channels as R8 (gray), RG8 (gray and alpha) or RGBA8, gray color images read as gray RGB.
+    // Each of these submits its own upload, the batch versions only record into the batch
+    Texture(std::string_view filename, TextureUsage usage = TextureUsage::eColor);
+    Texture(std::string_view filename, UploadBatch& batch, TextureUsage usage = TextureUsage::eColor);
+    // RGBA8 color
     Texture(void* data, uint32_t w, uint32_t h);
+    Texture(void* data, uint32_t w, uint32_t h, UploadBatch& batch);
+    // 8-bit pixels with 1, 2 or 4 channels
+    Texture(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, TextureUsage usage, UploadBatch& batch);
+    // Uploads prebuilt levels as they are, level 0 sets the size. Offsets are relative to data.
+    Texture(vk::Format format, const uint8_t* data, std::span<const MipLevel> levels, UploadBatch& batch);
     ~Texture();
 
+    // Format for 8-bit pixels with 1, 2 or 4 channels. channels becomes 4 for gray and alpha
+    // color, or when the device can't filter the narrower format, the pixels are then expanded to RGBA.
+    static vk::Format pixelFormat(uint32_t &channels, TextureUsage usage);
+
 private:
     void createImage(uint32_t w, uint32_t h);
     void createImageView();
     void allocMemory();
-    uint32_t queryImageMemoryIndex(size_t memTypeBits, vk::MemoryPropertyFlags memProperty);
-    void transitionImageLayoutFromUndefineToDst();
-    void transitionImageLayoutFromDstToOptimal();
-    void transformDataToImage(Buffer& buffer, uint32_t w, uint32_t h);
+    void transitionImageLayoutFromUndefineToDst(vk::CommandBuffer cmdBuf);
+    void transitionImageLayoutFromDstToOptimal(vk::CommandBuffer cmdBuf);
+    static bool supportLinearBlit(vk::Format format);
+    void generateMipmaps(vk::CommandBuffer cmdBuf, uint32_t w, uint32_t h);
+
+    void load(std::string_view filename, UploadBatch& batch, TextureUsage usage);
+    void init(const uint8_t* pixels, uint32_t w, uint32_t h, uint32_t channels, TextureUsage usage, UploadBatch& batch);
+    void initKtx2(const Ktx2File& ktx, UploadBatch& batch);
+    void initLevels(vk::Format levelFormat, const uint8_t* data, std::span<const MipLevel> levels, UploadBatch& batch);
+
+};
 
-    void init(void* data, uint32_t w, uint32_t h);
+// Index into the manager's slots plus the slot's generation, so a released handle never resolves to a reused slot
+struct TextureHandle {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
 
+    bool valid() const { return index != std::numeric_limits<uint32_t>::max(); }
+    bool operator==(const TextureHandle&) const = default;
 };
 
 class TextureManager final {
 public:
+    // Released textures are destroyed once framesInFlight update() calls later no frame can use them
+    TextureManager(uint32_t framesInFlight = 2);
+
     static TextureManager& instance() {
         if (!instance_) {
             instance_.reset(new TextureManager);
@@ -40,16 +85,82 @@ public:
         return *instance_;
     }
 
-    Texture* load(const std::string& filename);
-    Texture* create(void* data, uint32_t w, uint32_t h);
-    Texture* get(int i) const;
-    int size();
-    void destroy(Texture* texture);
+    // Loading a file that is already loaded, under the same canonical path or with the same content,
+    // returns the existing texture and adds a reference. Every handle is given back with release().
+    // The same file loaded with another usage is a separate texture.
+    TextureHandle load(const std::string& filename, TextureUsage usage = TextureUsage::eColor);
+    TextureHandle create(void* data, uint32_t w, uint32_t h);
+    // Only record the upload, the textures are usable once the batch was submitted
+    TextureHandle load(const std::string& filename, UploadBatch& batch, TextureUsage usage = TextureUsage::eColor);
+    TextureHandle create(void* data, uint32_t w, uint32_t h, UploadBatch& batch);
+    // Decodes the images on the thread pool while the ones already decoded are staged and uploaded,
+    // submitting whenever flushBytes were recorded. Handles follow filenames, invalid where a load failed.
+    std::vector<TextureHandle> loadBatch(std::span<const std::string> filenames, TextureUsage usage = TextureUsage::eColor, size_t flushBytes = 64ull << 20);
+    // Adds a reference to a handle that is already held
+    TextureHandle acquire(TextureHandle handle);
+    // The texture is destroyed after its last reference, once no frame in flight can sample it
+    void release(TextureHandle handle);
+    // nullptr for released handles
+    Texture* get(TextureHandle handle) const;
+    uint32_t refCount(TextureHandle handle) const;
+    int size() const;
+    // Waits for pending uploads before destroying every texture
     void clear();
+    // Once per frame on the render thread, destroys released textures no frame in flight can reference anymore
+    void update();
+
+    // The .ktx2 texture_compressor wrote next to path when there is one, path itself otherwise
+    static std::string compressedSibling(const std::string& path);
 
 private:
+    struct Slot {
+        std::unique_ptr<Texture> texture;
+        uint32_t generation = 0;
+        uint32_t refCount = 0;
+        std::vector<std::string> keys;      // pathKey()s it was loaded under, empty for created textures
+        uint64_t contentHash = 0;
+        uint64_t contentSize = 0;           // source file bytes, checked with the size on a hash hit
+        uint32_t width = 0;                 // 0 for .ktx2
+        uint32_t height = 0;
+    };
+
+    struct Retired {
+        std::unique_ptr<Texture> texture;
+        uint64_t frame;
+    };
+
+    // CPU half of a load, safe to run on any thread
+    struct Decoded {
+        std::string key;                    // canonical path that was asked for and the usage
+        std::string path;
+        std::string filename;               // file that was read, a .ktx2 is uploaded as stored
+        TextureUsage usage;
+        uint64_t contentHash = 0;           // of the file and the usage
+        uint64_t contentSize = 0;
+        std::shared_ptr<uint8_t> pixels;    // empty for .ktx2
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t channels = 0;
+    };
+
     static std::unique_ptr<TextureManager> instance_;
-    std::vector<std::unique_ptr<Texture>> datas_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    std::unordered_map<std::string, uint32_t> pathSlots_;       // every pathKey() a slot was loaded under
+    std::unordered_map<uint64_t, uint32_t> contentSlots_;
+    std::vector<Retired> retired_;
+    uint32_t framesInFlight_;
+    uint64_t frame_ = 0;
+    int count_ = 0;
+
+    const Slot* find(TextureHandle handle) const;
+    Slot* find(TextureHandle handle);
+    static std::string canonicalPath(const std::string& filename);
+    static std::string pathKey(const std::string& path, TextureUsage usage);
+    static Decoded decode(const std::string& path, TextureUsage usage, bool preferKtx2);
+    TextureHandle upload(Decoded& decoded, UploadBatch& batch);
+    // decoded is null for created textures, which are never shared
+    TextureHandle insert(std::unique_ptr<Texture> texture, const Decoded* decoded);
 
 };
 
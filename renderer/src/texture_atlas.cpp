@@ -0,0 +1,71 @@
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace huahualib {
+
+TextureAtlas::TextureAtlas(uint32_t pageSize, uint32_t padding)
+    : pageSize_(pageSize), padding_(std::bit_ceil(std::max(1u, padding))) {
+
+}
+
+std::span<const AtlasPage> TextureAtlas::pages() const {
+    return pages_;
+}
+
+uint32_t TextureAtlas::mipLevels() const {
+    return (uint32_t)std::countr_zero(padding_) + 1;
+}
+
+std::optional<AtlasRegion> TextureAtlas::add(const uint8_t* rgba, uint32_t w, uint32_t h) {
+    // One cell of border on each side, cells keep every block of padding_ texels on one image
+    uint32_t cellW = (w + padding_ - 1) / padding_ + 2;
+    uint32_t cellH = (h + padding_ - 1) / padding_ + 2;
+    uint32_t cells = pageSize_ / padding_;
+    if (w == 0 || h == 0 || cellW > cells || cellH > cells) return std::nullopt;
+
+    uint32_t cellX, cellY;
+    size_t page = 0;
+    while (page < packers_.size() && !packers_[page].pack(cellW, cellH, cellX, cellY)) {
+        ++ page;
+    }
+    if (page == packers_.size()) {
+        packers_.emplace_back(cells, cells);
+        pages_.push_back({pageSize_, pageSize_, std::vector<uint8_t>(4 * (size_t)pageSize_ * pageSize_, 0)});
+        packers_.back().pack(cellW, cellH, cellX, cellY);
+    }
+
+    copyPadded(pages_[page], rgba, w, h, cellX, cellY, cellW, cellH);
+
+    AtlasRegion region;
+    region.page = (uint32_t)page;
+    region.offset = glm::vec2((cellX + 1) * padding_, (cellY + 1) * padding_) / (float)pageSize_;
+    region.scale = glm::vec2(w, h) / (float)pageSize_;
+    return region;
+}
+
+void TextureAtlas::copyPadded(AtlasPage &page, const uint8_t* rgba, uint32_t w, uint32_t h, uint32_t cellX, uint32_t cellY, uint32_t cellW, uint32_t cellH) const {
+    // Every texel of the cells takes the nearest image texel, which replicates the border outwards
+    int32_t x0 = (int32_t)((cellX + 1) * padding_);
+    int32_t y0 = (int32_t)((cellY + 1) * padding_);
+    uint32_t spanW = cellW * padding_;
+    for (uint32_t row = 0; row < cellH * padding_; ++ row) {
+        uint32_t y = cellY * padding_ + row;
+        uint32_t srcY = (uint32_t)std::clamp((int32_t)y - y0, 0, (int32_t)h - 1);
+        const uint8_t* src = rgba + 4 * (size_t)srcY * w;
+        uint8_t* dst = page.rgba.data() + 4 * ((size_t)y * page.width + cellX * padding_);
+
+        uint32_t left = (uint32_t)(x0 - (int32_t)(cellX * padding_));
+        for (uint32_t i = 0; i < left; ++ i) {
+            memcpy(dst + 4 * i, src, 4);
+        }
+        memcpy(dst + 4 * left, src, 4 * (size_t)w);
+        for (uint32_t i = left + w; i < spanW; ++ i) {
+            memcpy(dst + 4 * i, src + 4 * (w - 1), 4);
+        }
+    }
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+#include "glm/glm.hpp"
+#include "rect_packer.h"
+
+namespace huahualib {
+
+// uv * scale + offset maps an image's [0, 1] texcoords into its page
+struct AtlasRegion final {
+    uint32_t page;
+    glm::vec2 offset;
+    glm::vec2 scale;
+};
+
+struct AtlasPage final {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> rgba;
+};
+
+// Packs small RGBA8 images into square pages. Images are placed on a grid of padding sized cells
+// with at least one cell of replicated border around them, so neither bilinear filtering nor
+// the first mipLevels() levels mix texels of neighbouring images.
+class TextureAtlas final {
+public:
+    // padding is rounded up to a power of two
+    TextureAtlas(uint32_t pageSize = 2048, uint32_t padding = 8);
+
+    // Empty when the image and its border do not fit in a page
+    std::optional<AtlasRegion> add(const uint8_t* rgba, uint32_t w, uint32_t h);
+
+    std::span<const AtlasPage> pages() const;
+    // Levels below would average texels across the border
+    uint32_t mipLevels() const;
+
+private:
+    uint32_t pageSize_;
+    uint32_t padding_;
+    std::vector<AtlasPage> pages_;
+    std::vector<RectPacker> packers_;   // in cells, one per page
+
+    void copyPadded(AtlasPage &page, const uint8_t* rgba, uint32_t w, uint32_t h, uint32_t cellX, uint32_t cellY, uint32_t cellW, uint32_t cellH) const;
+};
+
+}
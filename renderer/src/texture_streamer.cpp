@@ -0,0 +1,207 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "ktx2.h"
+#include "stb_image.h"
+
+namespace huahualib {
+
+TextureStreamer::TextureStreamer(const TextureStreamOptions &options, ThreadPool &pool): options_(options), pool_(pool) {}
+
+TextureStreamer::~TextureStreamer() {
+    for (auto& entry : entries_) {
+        if (entry && entry->decoding.valid()) entry->decoding.wait();
+    }
+}
+
+TextureStreamer::Handle TextureStreamer::request(const std::string &filename, TextureUsage usage) {
+    auto entry = std::make_unique<Entry>();
+    entry->filename = filename;
+    entry->usage = usage;
+    Entry* target = entry.get();
+    uint32_t tailSize = options_.tailSize;
+    entry->decoding = pool_.submit([target, tailSize]() {
+        decode(*target, tailSize);
+    });
+    if (!freeHandles_.empty()) {
+        Handle handle = freeHandles_.back();
+        freeHandles_.pop_back();
+        entries_[handle] = std::move(entry);
+        return handle;
+    }
+    entries_.push_back(std::move(entry));
+    return (Handle)(entries_.size() - 1);
+}
+
+void TextureStreamer::release(Handle handle) {
+    auto& entry = *entries_[handle];
+    entry.released = true;
+    if (entry.texture) retire(entry);
+    // A decode still running writes into the entry, update() frees it once that is done
+    if (!entry.decoding.valid() || entry.decoding.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        freeEntry(handle);
+    }
+}
+
+void TextureStreamer::freeEntry(Handle handle) {
+    if (entries_[handle]->decoding.valid()) entries_[handle]->decoding.get();
+    entries_[handle].reset();
+    freeHandles_.push_back(handle);
+}
+
+void TextureStreamer::markUsed(Handle handle, float screenSize) {
+    auto& entry = *entries_[handle];
+    // A texture drawn several times in a frame streams for its largest use
+    entry.screenSize = entry.lastUsed == frame_ ? std::max(entry.screenSize, screenSize) : screenSize;
+    entry.lastUsed = frame_;
+}
+
+Texture* TextureStreamer::texture(Handle handle) const {
+    return entries_[handle]->texture.get();
+}
+
+uint32_t TextureStreamer::generation(Handle handle) const {
+    return entries_[handle]->generation;
+}
+
+vk::DeviceSize TextureStreamer::residentBytes() const {
+    return residentBytes_;
+}
+
+void TextureStreamer::decode(Entry &entry, uint32_t tailSize) {
+    // Failures leave no levels behind, the entry then never gets a texture.
+    // A compressed .ktx2 next to the image is streamed instead, like TextureManager loads it.
+    auto filename = TextureManager::compressedSibling(entry.filename);
+    if (filename.ends_with(".ktx2")) {
+        Ktx2File ktx(filename);
+        if (!ktx.valid()) return;
+        entry.format = ktx.format();
+        size_t end = 0;
+        for (uint32_t i = 0; i < ktx.levels().size(); ++ i) {
+            end = std::max(end, ktx.levels()[i].offset + ktx.levelSize(i));
+        }
+        entry.data.assign(ktx.data(), ktx.data() + end);
+        entry.levels.assign(ktx.levels().begin(), ktx.levels().end());
+    } else {
+        int w, h, channel;
+        if (!stbi_info(entry.filename.c_str(), &w, &h, &channel)) return;
+        uint32_t channels = channel <= 2 ? (uint32_t)channel : 4;
+        entry.format = Texture::pixelFormat(channels, entry.usage);
+        stbi_uc* pexels = stbi_load(entry.filename.c_str(), &w, &h, &channel, (int)channels);
+        if (!pexels) return;
+        entry.levels = buildMipChain(pexels, (uint32_t)w, (uint32_t)h, channels, entry.usage == TextureUsage::eColor, entry.data);
+        stbi_image_free(pexels);
+    }
+
+    entry.tailLevel = (uint32_t)entry.levels.size() - 1;
+    while (entry.tailLevel > 0 && std::max(entry.levels[entry.tailLevel - 1].width, entry.levels[entry.tailLevel - 1].height) <= tailSize) {
+        -- entry.tailLevel;
+    }
+}
+
+uint32_t TextureStreamer::wantedLevel(const Entry &entry) const {
+    // Textures not drawn last frame only keep their tail
+    if (entry.lastUsed + 1 < frame_ || entry.screenSize <= 0.f) return entry.tailLevel;
+
+    float size = (float)std::max(entry.levels[0].width, entry.levels[0].height);
+    int level = (int)std::floor(std::log2(std::max(1.f, size / entry.screenSize)));
+    return (uint32_t)std::clamp(level, 0, (int)entry.tailLevel);
+}
+
+void TextureStreamer::makeResident(Entry &entry, uint32_t level, UploadBatch &batch) {
+    auto levels = std::span<const MipLevel>(entry.levels).subspan(level);
+    std::unique_ptr<Texture> texture;
+    try {
+        texture = std::make_unique<Texture>(entry.format, entry.data.data(), levels, batch);
+    } catch (const std::exception &e) {
+        std::cout << e.what() << "Stream texture " + entry.filename + " failed!" << std::endl;
+        entry.failed = true;
+        return;
+    }
+
+    if (entry.texture) retire(entry);
+    residentBytes_ += texture->memorySize;
+    entry.texture = std::move(texture);
+    entry.residentLevel = level;
+    ++ entry.generation;
+}
+
+bool TextureStreamer::evictFor(vk::DeviceSize bytes, const Entry* keep, UploadBatch &batch) {
+    // Least recently used first, textures drawn last frame only give up the detail they no longer want
+    while (residentBytes_ + bytes > options_.budget) {
+        Entry* victim = nullptr;
+        for (auto& entry : entries_) {
+            if (!entry || entry.get() == keep || !entry->texture || entry->failed || wantedLevel(*entry) <= entry->residentLevel) continue;
+            if (!victim || entry->lastUsed < victim->lastUsed) victim = entry.get();
+        }
+        if (!victim) return false;
+        makeResident(*victim, wantedLevel(*victim), batch);
+    }
+    return true;
+}
+
+void TextureStreamer::retire(Entry &entry) {
+    residentBytes_ -= entry.texture->memorySize;
+    retired_.push_back({std::move(entry.texture), frame_});
+}
+
+void TextureStreamer::update() {
+    ++ frame_;
+
+    std::erase_if(retired_, [&](const Retired &retired) {
+        return retired.frame + options_.framesInFlight < frame_;
+    });
+
+    UploadBatch batch;
+
+    // Newly decoded textures get their tail resident right away, it is small and not budgeted
+    for (Handle handle = 0; handle < entries_.size(); ++ handle) {
+        auto& entry = entries_[handle];
+        if (!entry || entry->decoded || !entry->decoding.valid()) continue;
+        if (entry->decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        if (entry->released) {
+            freeEntry(handle);
+            continue;
+        }
+        entry->decoding.get();
+        entry->decoded = true;
+        if (!entry->levels.empty()) makeResident(*entry, entry->tailLevel, batch);
+    }
+
+    // Upgrades in order of on-screen size, within the per frame upload limit
+    std::vector<Entry*> upgrades;
+    for (auto& entry : entries_) {
+        if (entry && entry->texture && !entry->released && !entry->failed && wantedLevel(*entry) < entry->residentLevel) {
+            upgrades.push_back(entry.get());
+        }
+    }
+    std::sort(upgrades.begin(), upgrades.end(), [](const Entry* a, const Entry* b) {
+        return a->screenSize > b->screenSize;
+    });
+
+    vk::DeviceSize uploaded = 0;
+    for (auto* entry : upgrades) {
+        uint32_t level = wantedLevel(*entry);
+        vk::DeviceSize bytes = 0;
+        for (uint32_t i = level; i < entry->levels.size(); ++ i) {
+            bytes += 4 * (vk::DeviceSize)entry->levels[i].width * entry->levels[i].height;
+        }
+        uint32_t blockBytes, blockDim;
+        formatBlockInfo(entry->format, blockBytes, blockDim);
+        bytes = bytes * blockBytes / (4 * blockDim * blockDim);
+
+        if (uploaded > 0 && uploaded + bytes > options_.uploadPerFrame) break;
+        if (!evictFor(bytes, entry, batch)) break;
+        makeResident(*entry, level, batch);
+        uploaded += bytes;
+    }
+
+    // Shrinking screen sizes free memory without waiting for a new upgrade
+    evictFor(0, nullptr, batch);
+
+    batch.flush();
+}
+
+}
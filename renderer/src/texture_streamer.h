@@ -0,0 +1,90 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "texture.h"
+#include "thread_pool.h"
+
+namespace huahualib {
+
+struct TextureStreamOptions {
+    vk::DeviceSize budget = 256ull << 20;           // resident texture memory before LRU eviction kicks in
+    vk::DeviceSize uploadPerFrame = 16ull << 20;    // bytes of mip upgrades per update()
+    uint32_t tailSize = 64;                         // levels up to this size are made resident right after decoding
+    uint32_t framesInFlight = 2;                    // replaced textures are destroyed once no frame can use them
+};
+
+// Streams textures in on worker threads. Each texture first gets its small mip tail resident,
+// then finer levels are uploaded by on-screen size, and the least recently used ones fall back
+// to the level they still need when the budget is exceeded. Changing residency replaces the texture, so users
+// refresh their descriptors whenever generation() changes.
+class TextureStreamer final {
+public:
+    using Handle = uint32_t;
+
+    TextureStreamer(const TextureStreamOptions &options = {}, ThreadPool &pool = ThreadPool::instance());
+    ~TextureStreamer();
+
+    // Starts decoding on the pool, texture() stays null until the tail is resident
+    Handle request(const std::string &filename, TextureUsage usage = TextureUsage::eColor);
+    // The texture may be in use by frames in flight, it is destroyed later. The CPU copy is freed
+    // once its decode is done and the handle may then be returned by a later request().
+    void release(Handle handle);
+
+    // The texture is drawn this frame, screenSize is about how many texels across it covers on screen
+    void markUsed(Handle handle, float screenSize);
+
+    // Once per frame on the render thread: uploads finished decodes and wanted mips in one submit,
+    // evicts over budget and destroys textures no frame in flight can reference anymore
+    void update();
+
+    Texture* texture(Handle handle) const;
+    uint32_t generation(Handle handle) const;
+    vk::DeviceSize residentBytes() const;
+
+private:
+    struct Entry {
+        std::string filename;
+        std::future<void> decoding;
+        bool decoded = false;
+        bool released = false;
+        bool failed = false;            // an upload failed, the entry keeps what it has
+
+        // CPU copy of the whole chain, filled by the worker
+        TextureUsage usage = TextureUsage::eColor;
+        vk::Format format = vk::Format::eUndefined;
+        std::vector<uint8_t> data;
+        std::vector<MipLevel> levels;
+        uint32_t tailLevel = 0;         // coarsest level set that is always resident
+
+        std::unique_ptr<Texture> texture;
+        uint32_t residentLevel = 0;     // finest resident level, only valid with a texture
+        uint32_t generation = 0;
+        uint64_t lastUsed = 0;
+        float screenSize = 0.f;
+    };
+
+    struct Retired {
+        std::unique_ptr<Texture> texture;
+        uint64_t frame;
+    };
+
+    TextureStreamOptions options_;
+    ThreadPool& pool_;
+    std::vector<std::unique_ptr<Entry>> entries_;  // null for released handles
+    std::vector<Handle> freeHandles_;
+    std::vector<Retired> retired_;
+    vk::DeviceSize residentBytes_ = 0;
+    uint64_t frame_ = 0;
+
+    static void decode(Entry &entry, uint32_t tailSize);
+    uint32_t wantedLevel(const Entry &entry) const;
+    void makeResident(Entry &entry, uint32_t level, UploadBatch &batch);
+    bool evictFor(vk::DeviceSize bytes, const Entry* keep, UploadBatch &batch);
+    void retire(Entry &entry);
+    void freeEntry(Handle handle);
+};
+
+}
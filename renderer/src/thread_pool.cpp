@@ -0,0 +1,110 @@
+#include "thread_pool.h"
+
+#include <atomic>
+
+namespace huahualib {
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    workers_.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++ i) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::size() const {
+    return (uint32_t)workers_.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(task));
+    }
+    cond_.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+    if (count == 0) return;
+    if (count == 1 || workers_.empty()) {
+        for (size_t i = 0; i < count; ++ i) func(i);
+        return;
+    }
+
+    // Items are claimed through a shared counter so uneven work balances itself.
+    // The caller takes part too, so it never idles while waiting on the pool. Helpers that
+    // only start once the caller is done find the loop closed and return without touching func.
+    struct State {
+        std::atomic<size_t> next = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+        uint32_t active = 0;
+        bool closed = false;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    auto run = [state, count, &func]() {
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            func(i);
+        }
+    };
+
+    size_t helpers = std::min<size_t>(workers_.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++ i) {
+        enqueue([state, run]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->closed) return;
+                ++ state->active;
+            }
+            std::exception_ptr error;
+            try {
+                run();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (error && !state->error) state->error = error;
+            if (-- state->active == 0) state->done.notify_all();
+        });
+    }
+
+    std::exception_ptr error;
+    try {
+        run();
+    } catch (...) {
+        error = std::current_exception();
+        state->next = count;    // stop the helpers early
+    }
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    state->done.wait(lock, [&]() { return state->active == 0; });
+    if (!error) error = state->error;
+    if (error) std::rethrow_exception(error);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace huahualib {
+
+class ThreadPool final {
+public:
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ThreadPool(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency()));
+    ~ThreadPool();
+
+    uint32_t size() const;
+
+    template<typename Func>
+    auto submit(Func&& func) -> std::future<decltype(func())> {
+        using Result = decltype(func());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        auto future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    // Runs func(i) for i in [0, count) across the pool and the calling thread, returns when all are done.
+    // Helpers still queued behind other tasks are not waited for, the caller takes their items.
+    // Must not be called from a task running on the same pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+};
+
+}
@@ -1,6 +1,8 @@
 
 #include "tool.h"
 
+#include <cstring>
+
 namespace huahualib {
 
 std::string readWholeFile(const std::string &filename) {
@@ -19,5 +21,24 @@ std::string readWholeFile(const std::string &filename) {
     return content;
 }
 
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    constexpr uint64_t prime = 1099511628211ull;
+    auto bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++ i) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return hash ^ (hash >> 32);
+}
+
 
 }
\ No newline at end of file
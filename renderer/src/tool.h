@@ -14,4 +14,7 @@ using CreateSurfaceFunc = std::function<vk::SurfaceKHR(vk::Instance)>;
 
 std::string readWholeFile(const std::string &filename);
 
+// 64-bit FNV-1a style hash, consumes 8 bytes per step.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
 }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace huahualib {
+
+// Triangles adjacent to each vertex, in CSR layout: the triangles around
+// vertex v are triangles[offsets[v], offsets[v] + counts[v]).
+struct TriangleAdjacency final {
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    TriangleAdjacency(std::span<const uint32_t> indices, size_t vertexCount)
+        : counts(vertexCount, 0), offsets(vertexCount, 0), triangles(indices.size()) {
+        for (auto index : indices) ++ counts[index];
+
+        uint32_t offset = 0;
+        for (size_t i = 0; i < vertexCount; ++ i) {
+            offsets[i] = offset;
+            offset += counts[i];
+        }
+
+        std::vector<uint32_t> fill = offsets;
+        for (size_t i = 0; i < indices.size(); ++ i) {
+            triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+        }
+    }
+};
+
+}
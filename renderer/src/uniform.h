@@ -24,6 +24,7 @@ struct MVP final {
     glm::mat4 modle;
     glm::mat4 view;
     glm::mat4 proj;
+    glm::vec4 texcoordTransform;   // CompactVertex texcoords: scale xy, offset zw
 };
 
 }
\ No newline at end of file
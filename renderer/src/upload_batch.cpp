@@ -0,0 +1,190 @@
+#include <algorithm>
+#include "upload_batch.h"
+#include "context.h"
+#include "ktx2.h"
+
+namespace huahualib {
+
+UploadBatch::~UploadBatch() {
+    flush();
+}
+
+vk::CommandBuffer UploadBatch::commandBuffer() {
+    auto& ctx = Context::getInstance();
+    if (!ctx.transferUploadQueuePtr) {
+        return graphicsCommandBuffer();
+    }
+    if (!transferRecording_) {
+        transferCmdBuf_ = ctx.transferUploadQueuePtr->acquire();
+        transferRecording_ = true;
+    }
+    return transferCmdBuf_;
+}
+
+vk::CommandBuffer UploadBatch::graphicsCommandBuffer() {
+    if (!recording_) {
+        cmdBuf_ = Context::getInstance().uploadQueuePtr->acquire();
+        recording_ = true;
+    }
+    return cmdBuf_;
+}
+
+StagingRing::Region UploadBatch::stage(const void* data, size_t size) {
+    auto& ring = *Context::getInstance().stagingRingPtr;
+    auto region = ring.allocate(this, size);
+    if (!region && (recording_ || transferRecording_)) {
+        // The ring may be full of what this batch staged so far, the retry waits for it
+        flush();
+        region = ring.allocate(this, size);
+    }
+    if (!region) {
+        staging_.push_back(std::make_unique<Buffer>(size,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+        region.buffer = staging_.back()->buffer;
+        region.size = size;
+        region.map = staging_.back()->map;
+    }
+    if (data) memcpy(region.map, data, size);
+    // Staged data is released by the next flush, which needs the batch to be recording
+    commandBuffer();
+    return region;
+}
+
+void UploadBatch::copyToBuffer(vk::Buffer dst, const void* data, size_t size, size_t dstOffset) {
+    auto chunk = (size_t)Context::getInstance().stagingRingPtr->chunkSize();
+    for (size_t copied = 0; copied < size; copied += chunk) {
+        auto piece = std::min(chunk, size - copied);
+        auto region = stage(static_cast<const uint8_t*>(data) + copied, piece);
+        vk::BufferCopy copy;
+        copy
+            .setSrcOffset(region.offset)
+            .setDstOffset(dstOffset + copied)
+            .setSize(piece);
+        commandBuffer().copyBuffer(region.buffer, dst, copy);
+    }
+
+    auto& ctx = Context::getInstance();
+    if (!ctx.transferUploadQueuePtr || size == 0) return;
+
+    // Release on the transfer queue and the matching acquire on the graphics queue
+    vk::BufferMemoryBarrier barrier;
+    barrier
+        .setBuffer(dst)
+        .setOffset(dstOffset)
+        .setSize(size)
+        .setSrcQueueFamilyIndex(ctx.transferUploadQueuePtr->queueFamily())
+        .setDstQueueFamilyIndex(ctx.uploadQueuePtr->queueFamily())
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    commandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, barrier, {});
+    barrier
+        .setSrcAccessMask({})
+        .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead);
+    graphicsCommandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eVertexInput, {}, {}, barrier, {});
+}
+
+void UploadBatch::copyToImage(vk::Image image, vk::Format format, const uint8_t* data, std::span<const MipLevel> levels) {
+    uint32_t blockBytes, blockDim;
+    formatBlockInfo(format, blockBytes, blockDim);
+    if (blockBytes == 0) {
+        throw std::runtime_error("Failed to upload image, unknown format!\n");
+    }
+
+    auto& ctx = Context::getInstance();
+    auto chunk = (size_t)ctx.stagingRingPtr->chunkSize();
+    // Transfer queues may only copy whole granules, counted in texel blocks for compressed formats
+    uint32_t granuleRows = ctx.transferUploadQueuePtr ? ctx.transferUploadQueuePtr->imageGranularity().height : 1;
+    for (uint32_t i = 0; i < levels.size(); ++ i) {
+        const auto& level = levels[i];
+        uint32_t blockRows = (level.height + blockDim - 1) / blockDim;
+        size_t rowBytes = (size_t)((level.width + blockDim - 1) / blockDim) * blockBytes;
+        uint32_t bandRows = (uint32_t)std::clamp<size_t>(chunk / rowBytes, 1, blockRows);
+        if (granuleRows == 0) {
+            bandRows = blockRows;
+        } else if (bandRows < blockRows) {
+            bandRows = std::max(granuleRows, bandRows / granuleRows * granuleRows);
+        }
+
+        vk::ImageSubresourceLayers subresource;
+        subresource
+            .setAspectMask(vk::ImageAspectFlagBits::eColor)
+            .setMipLevel(i)
+            .setBaseArrayLayer(0)
+            .setLayerCount(1);
+        for (uint32_t row = 0; row < blockRows; row += bandRows) {
+            uint32_t rows = std::min(bandRows, blockRows - row);
+            auto region = stage(data + level.offset + row * rowBytes, rows * rowBytes);
+            // The last band of a block compressed level may end inside its blocks
+            uint32_t y = row * blockDim;
+            vk::BufferImageCopy copy;
+            copy
+                .setBufferOffset(region.offset)
+                .setBufferRowLength(0)
+                .setBufferImageHeight(0)
+                .setImageSubresource(subresource)
+                .setImageOffset({0, (int32_t)y, 0})
+                .setImageExtent({level.width, std::min(rows * blockDim, level.height - y), 1});
+            commandBuffer().copyBufferToImage(region.buffer, image, vk::ImageLayout::eTransferDstOptimal, copy);
+        }
+    }
+}
+
+void UploadBatch::releaseImage(vk::Image image, uint32_t levelCount) {
+    auto& ctx = Context::getInstance();
+    if (!ctx.transferUploadQueuePtr) return;
+
+    vk::ImageSubresourceRange range;
+    range
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1)
+        .setBaseMipLevel(0)
+        .setLevelCount(levelCount);
+    vk::ImageMemoryBarrier barrier;
+    barrier
+        .setImage(image)
+        .setSubresourceRange(range)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSrcQueueFamilyIndex(ctx.transferUploadQueuePtr->queueFamily())
+        .setDstQueueFamilyIndex(ctx.uploadQueuePtr->queueFamily())
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    commandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+    barrier
+        .setSrcAccessMask({})
+        .setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+    graphicsCommandBuffer().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+}
+
+UploadToken UploadBatch::flush() {
+    if (!recording_ && !transferRecording_) return 0;
+
+    auto& ctx = Context::getInstance();
+    // The graphics part waits for the copies, so its token covers both
+    vk::Semaphore copies;
+    UploadToken copiesToken = 0;
+    if (transferRecording_) {
+        transferRecording_ = false;
+        copiesToken = ctx.transferUploadQueuePtr->submit(transferCmdBuf_);
+        copies = ctx.transferUploadQueuePtr->semaphore();
+    }
+    auto cmdBuf = graphicsCommandBuffer();
+    recording_ = false;
+    lastToken_ = ctx.uploadQueuePtr->submit(cmdBuf, copies, copiesToken);
+    ctx.stagingRingPtr->submitted(this, lastToken_);
+    for (auto& buffer : staging_) {
+        ctx.uploadQueuePtr->keepAlive(lastToken_, std::move(buffer));
+    }
+    staging_.clear();
+    ctx.stagingRingPtr->reclaim();
+    return lastToken_;
+}
+
+void UploadBatch::submit() {
+    flush();
+    auto& ctx = Context::getInstance();
+    ctx.uploadQueuePtr->wait(lastToken_);
+    ctx.stagingRingPtr->reclaim();
+}
+
+}
\ No newline at end of file
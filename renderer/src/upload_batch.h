@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+#include "buffer.h"
+#include "mipmap.h"
+#include "staging_ring.h"
+#include "upload_queue.h"
+
+namespace huahualib {
+
+// Records transfers for many buffers and textures into one command buffer and sends them to the
+// upload queue with a single submit. Data is staged in the context's staging ring, when the ring
+// is full of this batch's own data the batch flushes what it has and carries on. Everything the
+// recorded commands touch must stay alive until the returned token is reached, frames wait for it on the GPU.
+// With a dedicated transfer queue the copies run there and are handed over to the graphics queue,
+// whose part of the batch waits for them and is what the token stands for.
+class UploadBatch final {
+public:
+    UploadBatch() = default;
+    ~UploadBatch();     // flushes whatever is still pending
+
+    UploadBatch(const UploadBatch&) = delete;
+    UploadBatch& operator=(const UploadBatch&) = delete;
+
+    // Command buffer for copies and barriers of the transfer stage, on the transfer queue when there is one.
+    // Begun on first use. Staging may submit in between, so get it again after staging instead of keeping it.
+    vk::CommandBuffer commandBuffer();
+    // Command buffer on the graphics queue that runs after everything in commandBuffer(),
+    // for work a transfer queue can't do. The same one as commandBuffer() without a transfer queue.
+    vk::CommandBuffer graphicsCommandBuffer();
+    // Host visible memory filled with data, valid until the next flush. Sizes the ring can't hold get a buffer of their own.
+    StagingRing::Region stage(const void* data, size_t size);
+    // Stages data and records its copy into dst, in pieces when it is larger than the ring's chunk size.
+    // The range is handed over to the graphics queue for vertex input afterwards.
+    void copyToBuffer(vk::Buffer dst, const void* data, size_t size, size_t dstOffset = 0);
+    // Stages every level and records its copy into image, which must be in transfer dst layout.
+    // Level offsets are relative to data, levels larger than a chunk are copied in bands of rows.
+    void copyToImage(vk::Image image, vk::Format format, const uint8_t* data, std::span<const MipLevel> levels);
+    // Hands the first levelCount levels of image over to the graphics queue, staying in transfer dst layout.
+    // Call after the copies and before using the image in graphicsCommandBuffer().
+    void releaseImage(vk::Image image, uint32_t levelCount);
+
+    // Submits everything recorded so far without waiting, the batch can be reused right away
+    UploadToken flush();
+    // Flushes and waits for everything this batch submitted
+    void submit();
+
+private:
+    vk::CommandBuffer cmdBuf_;                  // graphics queue
+    vk::CommandBuffer transferCmdBuf_;
+    bool recording_ = false;
+    bool transferRecording_ = false;
+    UploadToken lastToken_ = 0;
+    std::vector<std::unique_ptr<Buffer>> staging_;  // oversized uploads only, handed to the queue on flush
+};
+
+}
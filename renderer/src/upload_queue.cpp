@@ -0,0 +1,133 @@
+#include "upload_queue.h"
+#include "context.h"
+
+namespace huahualib {
+
+UploadQueue::UploadQueue(vk::Queue queue, uint32_t queueFamily): queue_(queue), queueFamily_(queueFamily) {
+    auto& ctx = Context::getInstance();
+    auto& device = ctx.device;
+    imageGranularity_ = ctx.phyDevice.getQueueFamilyProperties()[queueFamily].minImageTransferGranularity;
+
+    vk::CommandPoolCreateInfo poolInfo;
+    poolInfo
+        .setQueueFamilyIndex(queueFamily)
+        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient);
+
+    vk::SemaphoreTypeCreateInfo typeInfo;
+    typeInfo
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+    vk::SemaphoreCreateInfo semaphoreInfo;
+    semaphoreInfo.setPNext(&typeInfo);
+
+    try {
+        cmdPool_ = device.createCommandPool(poolInfo);
+        timeline_ = device.createSemaphore(semaphoreInfo);
+    } catch (const std::exception &e) {
+        throw std::runtime_error("Failed to create upload queue!\n");
+    }
+}
+
+UploadQueue::~UploadQueue() {
+    auto& device = Context::getInstance().device;
+    wait(lastSubmitted_);
+    pending_.clear();
+    device.destroyCommandPool(cmdPool_);
+    device.destroySemaphore(timeline_);
+}
+
+vk::CommandBuffer UploadQueue::acquire() {
+    std::lock_guard lock(mutex_);
+    recycle();
+
+    vk::CommandBuffer cmdBuf;
+    if (!free_.empty()) {
+        cmdBuf = free_.back();
+        free_.pop_back();
+    } else {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo
+            .setCommandPool(cmdPool_)
+            .setCommandBufferCount(1)
+            .setLevel(vk::CommandBufferLevel::ePrimary);
+        try {
+            cmdBuf = Context::getInstance().device.allocateCommandBuffers(allocInfo)[0];
+        } catch (const std::exception &e) {
+            throw std::runtime_error("Failed to allocated command buffer!\n");
+        }
+    }
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    cmdBuf.begin(beginInfo);
+    return cmdBuf;
+}
+
+UploadToken UploadQueue::submit(vk::CommandBuffer cmdBuf, vk::Semaphore wait, UploadToken waitValue) {
+    cmdBuf.end();
+
+    std::lock_guard lock(mutex_);
+    UploadToken token = lastSubmitted_ + 1;
+    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setSignalSemaphoreValues(token);
+    vk::SubmitInfo submitInfo;
+    submitInfo
+        .setPNext(&timelineInfo)
+        .setCommandBuffers(cmdBuf)
+        .setSignalSemaphores(timeline_);
+    if (wait) {
+        timelineInfo.setWaitSemaphoreValues(waitValue);
+        submitInfo
+            .setWaitSemaphores(wait)
+            .setWaitDstStageMask(waitStage);
+    }
+    queue_.submit(submitInfo);
+
+    lastSubmitted_ = token;
+    pending_.push_back({token, cmdBuf, nullptr});
+    return token;
+}
+
+void UploadQueue::keepAlive(UploadToken token, std::shared_ptr<void> object) {
+    std::lock_guard lock(mutex_);
+    if (token == 0) return;
+    // Tokens are handed out in order, so a later one than the back keeps pending_ sorted
+    auto it = pending_.end();
+    while (it != pending_.begin() && std::prev(it)->token > token) {
+        -- it;
+    }
+    pending_.insert(it, {token, nullptr, std::move(object)});
+}
+
+bool UploadQueue::reached(UploadToken token) {
+    return token == 0 || completed() >= token;
+}
+
+void UploadQueue::wait(UploadToken token) {
+    if (reached(token)) return;
+    vk::SemaphoreWaitInfo waitInfo;
+    waitInfo
+        .setSemaphores(timeline_)
+        .setValues(token);
+    if (Context::getInstance().device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to wait for uploads!\n");
+    }
+}
+
+UploadToken UploadQueue::completed() {
+    return Context::getInstance().device.getSemaphoreCounterValue(timeline_);
+}
+
+void UploadQueue::recycle() {
+    auto done = completed();
+    while (!pending_.empty() && pending_.front().token <= done) {
+        if (auto cmdBuf = pending_.front().cmdBuf) {
+            cmdBuf.reset();
+            free_.push_back(cmdBuf);
+        }
+        pending_.pop_front();
+    }
+}
+
+}
\ No newline at end of file
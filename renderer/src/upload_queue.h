@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan.hpp"
+
+namespace huahualib {
+
+// Value of the upload queue's timeline semaphore that a submit signals, 0 is always reached
+using UploadToken = uint64_t;
+
+// Submits transfer work without waiting for it. Every submit signals the next value of one timeline
+// semaphore, the CPU waits on that value only when it must and the GPU waits on it in the frame that
+// first uses the result. Command buffers and anything kept alive with a token are recycled once it is reached.
+class UploadQueue final {
+public:
+    UploadQueue(vk::Queue queue, uint32_t queueFamily);
+    ~UploadQueue();     // waits for everything submitted
+
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // Begun for one time submit
+    vk::CommandBuffer acquire();
+    // Ends and submits cmdBuf, after wait has reached waitValue when it is given
+    UploadToken submit(vk::CommandBuffer cmdBuf, vk::Semaphore wait = {}, UploadToken waitValue = 0);
+    // object is destroyed once token is reached
+    void keepAlive(UploadToken token, std::shared_ptr<void> object);
+
+    bool reached(UploadToken token);
+    void wait(UploadToken token);
+    UploadToken completed();
+    UploadToken lastSubmitted() const { return lastSubmitted_; }
+    vk::Semaphore semaphore() const { return timeline_; }
+    uint32_t queueFamily() const { return queueFamily_; }
+    // Offsets and extents of image copies are multiples of this unless they reach the edge, 0 means whole levels only
+    vk::Extent3D imageGranularity() const { return imageGranularity_; }
+
+private:
+    struct Pending {
+        UploadToken token;
+        vk::CommandBuffer cmdBuf;               // null for kept objects
+        std::shared_ptr<void> object;
+    };
+
+    vk::Queue queue_;
+    uint32_t queueFamily_;
+    vk::Extent3D imageGranularity_;
+    vk::CommandPool cmdPool_;
+    vk::Semaphore timeline_;
+    UploadToken lastSubmitted_ = 0;
+    std::vector<vk::CommandBuffer> free_;
+    std::deque<Pending> pending_;               // in token order
+    std::mutex mutex_;
+
+    void recycle();
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include "vulkan/vulkan.hpp"
 
@@ -77,6 +78,93 @@ struct Vertex final {
     }
 };
 
+// Quantized vertex, 24 bytes against Vertex's 68:
+//   pos       unorm16 x4, relative to the mesh bounds (w unused)
+//   normal    snorm16 x2, octahedral encoding
+//   tangent   snorm8 x4, octahedral encoding in xy, bitangent sign in w
+//   texcoord  unorm16 x2, relative to the texcoord bounds
+//   color     unorm8 x4
+// Positions are mapped back to object space by VertexQuantization::matrix(),
+// which the renderer folds into the model matrix, texcoords by texcoordTransform().
+struct CompactVertex final {
+    uint16_t pos[4];
+    int16_t normal[2];
+    int8_t tangent[4];
+    uint16_t texcoord[2];
+    uint8_t color[4];
+
+    static std::vector<vk::VertexInputAttributeDescription> getAttribute() {
+        std::vector<vk::VertexInputAttributeDescription> attributes(5);
+        // pos
+        attributes[0]
+            .setBinding(0)
+            .setFormat(vk::Format::eR16G16B16A16Unorm)
+            .setLocation(0)
+            .setOffset(offsetof(CompactVertex, pos));
+        // normal
+        attributes[1]
+            .setBinding(0)
+            .setFormat(vk::Format::eR16G16Snorm)
+            .setLocation(1)
+            .setOffset(offsetof(CompactVertex, normal));
+        // tangent
+        attributes[2]
+            .setBinding(0)
+            .setFormat(vk::Format::eR8G8B8A8Snorm)
+            .setLocation(2)
+            .setOffset(offsetof(CompactVertex, tangent));
+        // texcoord
+        attributes[3]
+            .setBinding(0)
+            .setFormat(vk::Format::eR16G16Unorm)
+            .setLocation(3)
+            .setOffset(offsetof(CompactVertex, texcoord));
+        // color
+        attributes[4]
+            .setBinding(0)
+            .setFormat(vk::Format::eR8G8B8A8Unorm)
+            .setLocation(4)
+            .setOffset(offsetof(CompactVertex, color));
+        return attributes;
+    }
+
+    static vk::VertexInputBindingDescription getBinding() {
+        vk::VertexInputBindingDescription binding;
+        binding
+            .setBinding(0)
+            .setInputRate(vk::VertexInputRate::eVertex)
+            .setStride(sizeof(CompactVertex));
+        return binding;
+    }
+};
+
+// Maps unorm16 positions back to object space: pos = offset + unorm * scale
+struct VertexQuantization final {
+    glm::vec3 offset = glm::vec3(0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+    glm::vec2 texcoordOffset = glm::vec2(0.f);
+    glm::vec2 texcoordScale = glm::vec2(1.f);
+
+    glm::mat4 matrix() const {
+        glm::mat4 m(1.f);
+        m[0][0] = scale.x;
+        m[1][1] = scale.y;
+        m[2][2] = scale.z;
+        m[3] = glm::vec4(offset, 1.f);
+        return m;
+    }
+
+    // texcoord = texcoordOffset + unorm * texcoordScale, packed as scale xy, offset zw
+    glm::vec4 texcoordTransform() const {
+        return glm::vec4(texcoordScale, texcoordOffset);
+    }
+};
+
+enum class VertexFormat : uint32_t {
+    eFull,      // Vertex
+    eCompact,   // CompactVertex
+};
+
 }
 
 namespace std {
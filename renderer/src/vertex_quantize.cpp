@@ -0,0 +1,123 @@
+#include "vertex_quantize.h"
+
+#include <algorithm>
+#include <limits>
+#include "glm/gtc/packing.hpp"
+
+namespace huahualib {
+
+glm::vec2 octEncode(glm::vec3 n) {
+    float len = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (len == 0.f) return glm::vec2(0.f);
+
+    n /= len;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.f) {
+        // Fold the lower hemisphere over the diagonals
+        e = (1.f - glm::abs(glm::vec2(e.y, e.x))) * glm::vec2(e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f);
+    }
+    return e;
+}
+
+glm::vec3 octDecode(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+VertexQuantization quantizeVertices(std::span<const Vertex> vertices, std::vector<CompactVertex> &compact) {
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+    for (const auto& v : vertices) {
+        minPos = glm::min(minPos, v.pos);
+        maxPos = glm::max(maxPos, v.pos);
+    }
+
+    VertexQuantization quantization;
+    if (vertices.empty()) {
+        compact.clear();
+        return quantization;
+    }
+
+    // Flat axes keep a unit scale so the division below stays finite
+    glm::vec3 extent = maxPos - minPos;
+    quantization.offset = minPos;
+    quantization.scale = glm::vec3(
+        extent.x > 0.f ? extent.x : 1.f,
+        extent.y > 0.f ? extent.y : 1.f,
+        extent.z > 0.f ? extent.z : 1.f);
+    glm::vec3 invScale = 1.f / quantization.scale;
+
+    compact.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++ i) {
+        const auto& v = vertices[i];
+        auto& c = compact[i];
+
+        glm::vec3 p = glm::clamp((v.pos - quantization.offset) * invScale, 0.f, 1.f);
+        c.pos[0] = glm::packUnorm1x16(p.x);
+        c.pos[1] = glm::packUnorm1x16(p.y);
+        c.pos[2] = glm::packUnorm1x16(p.z);
+        c.pos[3] = 0;
+
+        glm::vec2 n = octEncode(v.normal);
+        c.normal[0] = (int16_t)glm::packSnorm1x16(n.x);
+        c.normal[1] = (int16_t)glm::packSnorm1x16(n.y);
+
+        glm::vec2 t = octEncode(v.tangent);
+        float handedness = glm::dot(glm::cross(v.normal, v.tangent), v.bitangent) < 0.f ? -1.f : 1.f;
+        c.tangent[0] = (int8_t)glm::packSnorm1x8(t.x);
+        c.tangent[1] = (int8_t)glm::packSnorm1x8(t.y);
+        c.tangent[2] = 0;
+        c.tangent[3] = (int8_t)glm::packSnorm1x8(handedness);
+
+        glm::vec3 color = glm::clamp(v.color, 0.f, 1.f);
+        c.color[0] = glm::packUnorm1x8(color.r);
+        c.color[1] = glm::packUnorm1x8(color.g);
+        c.color[2] = glm::packUnorm1x8(color.b);
+        c.color[3] = 255;
+    }
+    quantizeTexcoords(vertices, compact, quantization);
+
+    return quantization;
+}
+
+void quantizeTexcoords(std::span<const Vertex> vertices, std::span<CompactVertex> compact, VertexQuantization &quantization) {
+    glm::vec2 minUv(std::numeric_limits<float>::max());
+    glm::vec2 maxUv(std::numeric_limits<float>::lowest());
+    for (const auto& v : vertices) {
+        minUv = glm::min(minUv, v.texcoord);
+        maxUv = glm::max(maxUv, v.texcoord);
+    }
+    if (vertices.empty()) return;
+
+    // unorm16 over the actual range keeps atlas UVs well under a texel, half floats lose it near 1.0
+    glm::vec2 extent = maxUv - minUv;
+    quantization.texcoordOffset = minUv;
+    quantization.texcoordScale = glm::vec2(
+        extent.x > 0.f ? extent.x : 1.f,
+        extent.y > 0.f ? extent.y : 1.f);
+    glm::vec2 invScale = 1.f / quantization.texcoordScale;
+
+    for (size_t i = 0; i < vertices.size(); ++ i) {
+        glm::vec2 uv = glm::clamp((vertices[i].texcoord - quantization.texcoordOffset) * invScale, 0.f, 1.f);
+        compact[i].texcoord[0] = glm::packUnorm1x16(uv.x);
+        compact[i].texcoord[1] = glm::packUnorm1x16(uv.y);
+    }
+}
+
+Vertex dequantizeVertex(const CompactVertex &c, const VertexQuantization &quantization) {
+    Vertex v = {};
+    glm::vec3 p(glm::unpackUnorm1x16(c.pos[0]), glm::unpackUnorm1x16(c.pos[1]), glm::unpackUnorm1x16(c.pos[2]));
+    v.pos = quantization.offset + p * quantization.scale;
+    v.normal = octDecode({glm::unpackSnorm1x16((uint16_t)c.normal[0]), glm::unpackSnorm1x16((uint16_t)c.normal[1])});
+    v.tangent = octDecode({glm::unpackSnorm1x8((uint8_t)c.tangent[0]), glm::unpackSnorm1x8((uint8_t)c.tangent[1])});
+    v.bitangent = glm::cross(v.normal, v.tangent) * glm::unpackSnorm1x8((uint8_t)c.tangent[3]);
+    v.color = {glm::unpackUnorm1x8(c.color[0]), glm::unpackUnorm1x8(c.color[1]), glm::unpackUnorm1x8(c.color[2])};
+    glm::vec2 uv(glm::unpackUnorm1x16(c.texcoord[0]), glm::unpackUnorm1x16(c.texcoord[1]));
+    v.texcoord = quantization.texcoordOffset + uv * quantization.texcoordScale;
+    return v;
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include "vertex.h"
+
+namespace huahualib {
+
+// Encodes vertices into CompactVertex, positions are quantized against the bounds of the whole span
+VertexQuantization quantizeVertices(std::span<const Vertex> vertices, std::vector<CompactVertex> &compact);
+
+// Requantizes only the texcoords against their own bounds, for when they change after quantizeVertices
+void quantizeTexcoords(std::span<const Vertex> vertices, std::span<CompactVertex> compact, VertexQuantization &quantization);
+
+// Decodes back to a full vertex, the bitangent is rebuilt from normal, tangent and sign
+Vertex dequantizeVertex(const CompactVertex &vertex, const VertexQuantization &quantization);
+
+glm::vec2 octEncode(glm::vec3 n);
+glm::vec3 octDecode(glm::vec2 e);
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "vertex.h"
+
+namespace huahualib {
+
+// Flat open-addressing table used to weld identical vertices.
+//
+// Slots only hold a 32-bit hash and the welded vertex index. Keys live with the
+// caller (the vertex array or a parallel key array) and are compared through a
+// predicate, so a lookup is one linear probe sequence over 8-byte slots and
+// inserts never allocate. The table is sized once from the expected element
+// count and never grows.
+class WeldTable final {
+public:
+    WeldTable(size_t expectedCount) {
+        size_t capacity = std::bit_ceil(std::max<size_t>(16, expectedCount * 2));
+        slots_.assign(capacity, {0, kEmpty});
+        mask_ = capacity - 1;
+    }
+
+    // Returns {index, true} after inserting newIndex, or {existing index, false}
+    // when equal(existing index) matches. Must not be called with more than
+    // expectedCount distinct keys.
+    template<typename Equal>
+    std::pair<uint32_t, bool> findOrInsert(uint32_t hash, uint32_t newIndex, Equal&& equal) {
+        for (size_t i = hash & mask_; ; i = (i + 1) & mask_) {
+            auto& slot = slots_[i];
+            if (slot.index == kEmpty) {
+                slot = {hash, newIndex};
+                return {newIndex, true};
+            }
+            if (slot.hash == hash && equal(slot.index)) {
+                return {slot.index, false};
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t kEmpty = 0xffffffffu;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+};
+
+inline uint32_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+// Hash of an OBJ (position, normal, texcoord) index triple
+inline uint32_t hashIndexTriple(int v, int vn, int vt) {
+    uint64_t h = (uint64_t)(uint32_t)v * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t)(uint32_t)vn * 0xc2b2ae3d27d4eb4full + (h << 6);
+    h ^= (uint64_t)(uint32_t)vt * 0x165667b19e3779f9ull + (h >> 2);
+    return mixHash(h);
+}
+
+// Hash over every attribute of the vertex, consistent with Vertex::operator==
+inline uint32_t hashVertex(const Vertex &vertex) {
+    constexpr size_t count = sizeof(Vertex) / sizeof(float);
+    float values[count];
+    memcpy(values, &vertex, sizeof(Vertex));
+
+    uint64_t h = 0;
+    for (size_t i = 0; i < count; ++ i) {
+        uint32_t bits;
+        float value = values[i] + 0.f;    // fold -0 into +0
+        memcpy(&bits, &value, sizeof(bits));
+        h = (h ^ bits) * 0x100000001b3ull;
+    }
+    return mixHash(h);
+}
+
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "block_compression.h"
+#include "ktx2.h"
+#include "mipmap.h"
+#include "stb_image.h"
+
+// Converts images into block compressed KTX2 files with a full mip chain.
+// TextureManager::load picks up a .ktx2 placed next to the image it was asked for.
+// Usage: texture_compressor [--format bc1|bc3|bc5|bc7] [--linear] [--no-mips] <image> [output.ktx2]
+
+using Clock = std::chrono::high_resolution_clock;
+
+static void usage() {
+    std::cout << "Usage: texture_compressor [--format bc1|bc3|bc5|bc7] [--linear] [--no-mips] <image> [output.ktx2]\n"
+              << "    bc1  RGB with 1 bit alpha, 8:1\n"
+              << "    bc3  RGBA with smooth alpha, 4:1\n"
+              << "    bc5  two channel normal maps, 4:1, always linear\n"
+              << "    bc7  high quality RGBA, 4:1 (default)\n"
+              << "    --linear  data textures, mips are filtered and sampled without sRGB decoding\n";
+}
+
+int main(int argc, char** argv) {
+    huahualib::BlockFormat format = huahualib::BlockFormat::eBC7;
+    bool srgb = true;
+    bool mips = true;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++ i) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            std::string name = argv[++ i];
+            if (name == "bc1") format = huahualib::BlockFormat::eBC1;
+            else if (name == "bc3") format = huahualib::BlockFormat::eBC3;
+            else if (name == "bc5") format = huahualib::BlockFormat::eBC5;
+            else if (name == "bc7") format = huahualib::BlockFormat::eBC7;
+            else {
+                usage();
+                return 1;
+            }
+        } else if (arg == "--linear") {
+            srgb = false;
+        } else if (arg == "--no-mips") {
+            mips = false;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty() || files.size() > 2) {
+        usage();
+        return 1;
+    }
+    if (format == huahualib::BlockFormat::eBC5) srgb = false;
+
+    std::string input = files[0];
+    std::string output = files.size() > 1 ? files[1] : std::filesystem::path(input).replace_extension(".ktx2").string();
+
+    int w, h, channel;
+    stbi_uc* pexels = stbi_load(input.c_str(), &w, &h, &channel, STBI_rgb_alpha);
+    if (!pexels) {
+        std::cout << "Load " << input << " failed!" << std::endl;
+        return 1;
+    }
+
+    auto start = Clock::now();
+    std::vector<uint8_t> chain;
+    std::vector<huahualib::MipLevel> mipLevels;
+    if (mips) {
+        mipLevels = huahualib::buildMipChain(pexels, (uint32_t)w, (uint32_t)h, srgb, chain);
+    } else {
+        chain.assign(pexels, pexels + 4 * (size_t)w * h);
+        mipLevels.push_back({0, (uint32_t)w, (uint32_t)h});
+    }
+    stbi_image_free(pexels);
+
+    std::vector<std::vector<uint8_t>> levels(mipLevels.size());
+    size_t compressedSize = 0;
+    for (size_t i = 0; i < mipLevels.size(); ++ i) {
+        const auto& level = mipLevels[i];
+        huahualib::compressImage(format, chain.data() + level.offset, level.width, level.height, levels[i]);
+        compressedSize += levels[i].size();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (!huahualib::writeKtx2(output, huahualib::blockVkFormat(format, srgb), (uint32_t)w, (uint32_t)h, levels)) {
+        std::cout << "Write " << output << " failed!" << std::endl;
+        return 1;
+    }
+
+    std::cout << input << " -> " << output << ": " << w << "x" << h << ", " << levels.size() << " levels, "
+              << chain.size() / 1024 << " KB -> " << compressedSize / 1024 << " KB ("
+              << (double)chain.size() / compressedSize << ":1) in " << ms << " ms" << std::endl;
+    return 0;
+}